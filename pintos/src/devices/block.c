@@ -19,8 +19,18 @@ struct block
 
     unsigned long long read_cnt;        /* Number of sectors read. */
     unsigned long long write_cnt;       /* Number of sectors written. */
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+    block_sector_t next_sector;         /* Sector after last accessed. */
+    unsigned long long seek_dist;       /* Total sectors skipped by seeks. */
+    unsigned long long long_seeks;      /* Seeks over LONG_SEEK sectors. */
+/////////////////////////////////////////////////////////////////////////////
   };
 
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+/* Seeks farther than this many sectors count as long. */
+#define LONG_SEEK 1024
+/////////////////////////////////////////////////////////////////////////////
+
 /* List of all block devices. */
 static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 
@@ -28,6 +38,9 @@ static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 static struct block *block_by_role[BLOCK_ROLE_CNT];
 
 static struct block *list_elem_to_block (struct list_elem *);
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+static void count_seek (struct block *, block_sector_t);
+/////////////////////////////////////////////////////////////////////////////
 
 /* Returns a human-readable name for the given block device
    TYPE. */
@@ -123,6 +136,9 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
   check_sector (block, sector);
   block->ops->read (block->aux, sector, buffer);
   block->read_cnt++;
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  count_seek (block, sector);
+/////////////////////////////////////////////////////////////////////////////
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -137,6 +153,9 @@ block_write (struct block *block, block_sector_t sector, const void *buffer)
   ASSERT (block->type != BLOCK_FOREIGN);
   block->ops->write (block->aux, sector, buffer);
   block->write_cnt++;
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  count_seek (block, sector);
+/////////////////////////////////////////////////////////////////////////////
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -178,6 +197,47 @@ block_print_stats (void)
     }
 }
 
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+/* Stores number of sectors read from and written to BLOCK into
+   *READ_CNT and *WRITE_CNT. */
+void
+block_get_stats (struct block *block, unsigned long long *read_cnt,
+                 unsigned long long *write_cnt)
+{
+  *read_cnt = block->read_cnt;
+  *write_cnt = block->write_cnt;
+}
+
+/* Stores total distance in sectors of BLOCK's head movements,
+   and how many of them went over LONG_SEEK sectors, into
+   *SEEK_DIST and *LONG_SEEKS. */
+void
+block_get_seek_stats (struct block *block, unsigned long long *seek_dist,
+                      unsigned long long *long_seeks)
+{
+  *seek_dist = block->seek_dist;
+  *long_seeks = block->long_seeks;
+}
+
+/* Account for an access to SECTOR of BLOCK that doesn't follow
+   the last one. Like read_cnt, these are updated without a lock
+   and are only approximate under concurrent access. */
+static void
+count_seek (struct block *block, block_sector_t sector)
+{
+  if (sector != block->next_sector)
+    {
+      block_sector_t dist = sector > block->next_sector
+                            ? sector - block->next_sector
+                            : block->next_sector - sector;
+      block->seek_dist += dist;
+      if (dist > LONG_SEEK)
+        block->long_seeks++;
+    }
+  block->next_sector = sector + 1;
+}
+/////////////////////////////////////////////////////////////////////////////
+
 /* Registers a new block device with the given NAME.  If
    EXTRA_INFO is non-null, it is printed as part of a user
    message.  The block device's SIZE in sectors and its TYPE must
@@ -200,6 +260,11 @@ block_register (const char *name, enum block_type type,
   block->aux = aux;
   block->read_cnt = 0;
   block->write_cnt = 0;
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  block->next_sector = 0;
+  block->seek_dist = 0;
+  block->long_seeks = 0;
+/////////////////////////////////////////////////////////////////////////////
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
@@ -58,6 +58,12 @@ enum block_type block_type (struct block *);
 
 /* Statistics. */
 void block_print_stats (void);
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+void block_get_stats (struct block *, unsigned long long *read_cnt,
+                      unsigned long long *write_cnt);
+void block_get_seek_stats (struct block *, unsigned long long *seek_dist,
+                           unsigned long long *long_seeks);
+/////////////////////////////////////////////////////////////////////////////
 
 /* Lower-level interface to block device drivers. */
 
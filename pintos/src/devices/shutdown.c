@@ -12,6 +12,11 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "filesys/filesys.h"
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+#include "filesys/buffer_cache.h"
+#include "filesys/dentry_cache.h"
+#include "filesys/journal.h"
+/////////////////////////////////////////////////////////////////////////////
 #endif
 
 /* Keyboard control register port. */
@@ -127,6 +132,11 @@ print_stats (void)
   thread_print_stats ();
 #ifdef FILESYS
   block_print_stats ();
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  bc_print_stats ();
+  dc_print_stats ();
+  journal_print_stats ();
+/////////////////////////////////////////////////////////////////////////////
 #endif
   console_print_stats ();
   kbd_print_stats ();
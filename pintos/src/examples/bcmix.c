@@ -0,0 +1,109 @@
+/* bcmix.c
+
+   Mixes a streaming reader with a metadata-heavy workload, to
+   compare buffer cache replacement policies.  Each round reads
+   the next chunk of one large file, then opens and reads a set
+   of small files.  The small files and the directory are the hot
+   set; the streamed sectors are used once.
+
+   Run it under each policy and compare the disk reads in the
+   statistics printed at shutdown, or run it under cachestat for
+   hit ratios, e.g.
+       pintos -f -q -bcpolicy=arc run 'cachestat bcmix 512 32' */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+#define CHUNK 4096
+
+static char buf[CHUNK];
+
+/* Creates file NAME of SIZE bytes filled with nonzero data. */
+static void
+make_file (const char *name, int size)
+{
+  int fd, ofs;
+
+  memset (buf, 'x', sizeof buf);
+  if (!create (name, 0))
+    {
+      printf ("%s: create failed\n", name);
+      exit (1);
+    }
+  fd = open (name);
+  if (fd < 0)
+    {
+      printf ("%s: open failed\n", name);
+      exit (1);
+    }
+  for (ofs = 0; ofs < size; ofs += CHUNK)
+    {
+      int n = size - ofs < CHUNK ? size - ofs : CHUNK;
+      if (write (fd, buf, n) != n)
+        {
+          printf ("%s: write failed\n", name);
+          exit (1);
+        }
+    }
+  close (fd);
+}
+
+int
+main (int argc, char *argv[])
+{
+  int stream_kb = argc > 1 ? atoi (argv[1]) : 512;
+  int meta_cnt = argc > 2 ? atoi (argv[2]) : 32;
+  int stream_fd, lookups = 0, streamed = 0;
+  char name[16];
+  int i;
+
+  if (stream_kb <= 0 || meta_cnt <= 0)
+    {
+      printf ("usage: bcmix [STREAM_KB] [META_FILES]\n");
+      return EXIT_FAILURE;
+    }
+
+  make_file ("stream", stream_kb * 1024);
+  for (i = 0; i < meta_cnt; i++)
+    {
+      snprintf (name, sizeof name, "meta%d", i);
+      make_file (name, 200);
+    }
+
+  stream_fd = open ("stream");
+  if (stream_fd < 0)
+    {
+      printf ("stream: open failed\n");
+      return EXIT_FAILURE;
+    }
+  for (;;)
+    {
+      int n = read (stream_fd, buf, CHUNK);
+      if (n <= 0)
+        break;
+      streamed += n;
+
+      for (i = 0; i < meta_cnt; i++)
+        {
+          int fd;
+
+          snprintf (name, sizeof name, "meta%d", i);
+          fd = open (name);
+          if (fd < 0)
+            {
+              printf ("%s: open failed\n", name);
+              return EXIT_FAILURE;
+            }
+          read (fd, buf, 64);
+          close (fd);
+          lookups++;
+        }
+    }
+  close (stream_fd);
+
+  printf ("bcmix: streamed %d bytes, %d small file lookups\n",
+          streamed, lookups);
+  return EXIT_SUCCESS;
+}
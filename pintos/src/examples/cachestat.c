@@ -0,0 +1,119 @@
+/* cachestat.c
+
+   Prints buffer cache and file system device statistics.
+   With arguments, runs them as a command first and prints only
+   the counts caused while it ran, e.g.
+       cachestat bcmix 512 32 */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+
+static const char *class_names[CACHE_CLASS_CNT] = {"inode", "indirect",
+                                                    "data", "metadata"};
+
+/* Returns the hit ratio of HITS out of HITS + MISSES, in tenths
+   of a percent. */
+static int
+permille (unsigned long long hits, unsigned long long misses)
+{
+  unsigned long long total = hits + misses;
+  return total > 0 ? (int) (hits * 1000 / total) : 0;
+}
+
+/* Prints S, as a difference from BASE if BASE is nonnull. */
+static void
+print_stats (const struct cache_stats *s, const struct cache_stats *base)
+{
+  struct cache_stats d = *s;
+  int i;
+
+  if (base != NULL)
+    {
+      d.hits -= base->hits;
+      d.misses -= base->misses;
+      d.evictions -= base->evictions;
+      d.write_backs -= base->write_backs;
+      d.ra_reads -= base->ra_reads;
+      d.ra_hits -= base->ra_hits;
+      d.ra_wasted -= base->ra_wasted;
+      d.lock_waits -= base->lock_waits;
+      for (i = 0; i < CACHE_CLASS_CNT; i++)
+        {
+          d.class_hits[i] -= base->class_hits[i];
+          d.class_misses[i] -= base->class_misses[i];
+        }
+      d.disk_reads -= base->disk_reads;
+      d.disk_writes -= base->disk_writes;
+      d.disk_seek_dist -= base->disk_seek_dist;
+      d.disk_long_seeks -= base->disk_long_seeks;
+      d.dc_hits -= base->dc_hits;
+      d.dc_neg_hits -= base->dc_neg_hits;
+      d.dc_misses -= base->dc_misses;
+      d.journal_commits -= base->journal_commits;
+      d.journal_log_writes -= base->journal_log_writes;
+      d.journal_checkpoints -= base->journal_checkpoints;
+    }
+
+  printf ("cache: %u entries, %u dirty\n", d.entry_cnt, d.dirty_cnt);
+  printf ("lookups: %llu hits, %llu misses (%d.%d%% hit)\n",
+          d.hits, d.misses, permille (d.hits, d.misses) / 10,
+          permille (d.hits, d.misses) % 10);
+  for (i = 0; i < CACHE_CLASS_CNT; i++)
+    printf ("  %-8s %llu hits, %llu misses\n", class_names[i],
+            d.class_hits[i], d.class_misses[i]);
+  printf ("evictions: %llu, write backs: %llu, lock waits: %llu\n",
+          d.evictions, d.write_backs, d.lock_waits);
+  printf ("read ahead: %llu sectors, %llu used, %llu wasted\n",
+          d.ra_reads, d.ra_hits, d.ra_wasted);
+  printf ("disk: %llu reads, %llu writes\n", d.disk_reads, d.disk_writes);
+  printf ("seeks: %llu sectors total, %llu long\n",
+          d.disk_seek_dist, d.disk_long_seeks);
+  printf ("dentry cache: %llu hits, %llu negative hits, %llu misses "
+          "(%d.%d%% hit)\n", d.dc_hits, d.dc_neg_hits, d.dc_misses,
+          permille (d.dc_hits + d.dc_neg_hits, d.dc_misses) / 10,
+          permille (d.dc_hits + d.dc_neg_hits, d.dc_misses) % 10);
+  printf ("journal: %llu commits, %llu sectors logged, %llu written home\n",
+          d.journal_commits, d.journal_log_writes, d.journal_checkpoints);
+}
+
+int
+main (int argc, char *argv[])
+{
+  struct cache_stats before, after;
+  char cmd[128];
+  pid_t pid;
+  int i;
+
+  if (!cachestat (&before))
+    {
+      printf ("cachestat: system call failed\n");
+      return EXIT_FAILURE;
+    }
+  if (argc < 2)
+    {
+      print_stats (&before, NULL);
+      return EXIT_SUCCESS;
+    }
+
+  /* Join arguments back into a command line. */
+  cmd[0] = '\0';
+  for (i = 1; i < argc; i++)
+    {
+      if (i > 1)
+        strlcat (cmd, " ", sizeof cmd);
+      strlcat (cmd, argv[i], sizeof cmd);
+    }
+
+  pid = exec (cmd);
+  if (pid == PID_ERROR)
+    {
+      printf ("%s: exec failed\n", argv[1]);
+      return EXIT_FAILURE;
+    }
+  printf ("%s: exit(%d)\n", argv[1], wait (pid));
+
+  cachestat (&after);
+  print_stats (&after, &before);
+  return EXIT_SUCCESS;
+}
@@ -37,6 +37,12 @@ main (int argc, char *argv[])
       return EXIT_FAILURE;
     }
 
+  /* Reserve space up front so the copy doesn't allocate sector by
+     sector.  The size grows only as data is written, so a copy cut
+     short never shows unwritten sectors.  Failure is harmless:
+     writes allocate as they go. */
+  fallocate (out_fd, filesize (in_fd), FALLOC_NO_ZERO | FALLOC_KEEP_SIZE);
+
   /* Copy data. */
   for (;;) 
     {
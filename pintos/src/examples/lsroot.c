@@ -0,0 +1,41 @@
+/* lsroot.c
+
+   Lists the root directory with readdirs(), which returns many
+   names per call, then prints how many calls and disk reads
+   that took.  The disk reads come from cachestat(), so they
+   include any other process's reads at the same time. */
+
+#include <stdio.h>
+#include <syscall.h>
+
+int
+main (void)
+{
+  static char names[READDIRS_MAX][READDIR_MAX_LEN + 1];
+  struct cache_stats before, after;
+  unsigned pos = 0;
+  int total = 0, calls = 0;
+  int n, i;
+
+  if (!cachestat (&before))
+    return EXIT_FAILURE;
+  do
+    {
+      n = readdirs (&pos, names, READDIRS_MAX);
+      if (n < 0)
+        {
+          printf ("lsroot: readdirs failed\n");
+          return EXIT_FAILURE;
+        }
+      for (i = 0; i < n; i++)
+        printf ("%s\n", names[i]);
+      total += n;
+      calls++;
+    }
+  while (n > 0);
+  cachestat (&after);
+
+  printf ("%d names in %d calls, %llu disk reads\n", total, calls,
+          after.disk_reads - before.disk_reads);
+  return EXIT_SUCCESS;
+}
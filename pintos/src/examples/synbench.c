@@ -0,0 +1,132 @@
+/* synbench.c
+
+   Stress test for concurrent writers, modelled on the syn-write
+   test.  Spawns several copies of itself, each of which writes
+   its own part of one shared file over and over, then waits for
+   them, reads the file back and verifies every byte.
+
+   Disjoint writes to one file no longer serialize, so compare the
+   timer ticks printed at shutdown for different child counts, e.g.
+       pintos -f -q run 'synbench 1 64'
+       pintos -f -q run 'synbench 8 64' */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+#define CHUNK_SIZE 2048
+#define MAX_CHILDREN 16
+
+static const char file_name[] = "synbench.dat";
+static char buf[CHUNK_SIZE];
+static char expected[CHUNK_SIZE];
+
+/* Fills BUF with the pattern child IDX writes in round ROUND. */
+static void
+fill (int idx, int round)
+{
+  int i;
+
+  for (i = 0; i < CHUNK_SIZE; i++)
+    buf[i] = 'a' + (idx + round + i) % 26;
+}
+
+/* Writes chunk IDX of the file ROUNDS times; the last round's
+   pattern is what the parent checks for. */
+static int
+child (int idx, int rounds)
+{
+  int fd, round;
+
+  fd = open (file_name);
+  if (fd < 0)
+    {
+      printf ("synbench child %d: open failed\n", idx);
+      return EXIT_FAILURE;
+    }
+  for (round = 0; round < rounds; round++)
+    {
+      fill (idx, round);
+      seek (fd, CHUNK_SIZE * idx);
+      if (write (fd, buf, CHUNK_SIZE) != CHUNK_SIZE)
+        {
+          printf ("synbench child %d: write failed\n", idx);
+          return EXIT_FAILURE;
+        }
+    }
+  close (fd);
+  return EXIT_SUCCESS;
+}
+
+int
+main (int argc, char *argv[])
+{
+  pid_t children[MAX_CHILDREN];
+  char cmd[64];
+  int child_cnt, rounds;
+  int fd, i, failed = 0;
+
+  if (argc == 4 && !strcmp (argv[1], "child"))
+    return child (atoi (argv[2]), atoi (argv[3]));
+
+  child_cnt = argc > 1 ? atoi (argv[1]) : 8;
+  rounds = argc > 2 ? atoi (argv[2]) : 64;
+  if (child_cnt <= 0 || child_cnt > MAX_CHILDREN || rounds <= 0)
+    {
+      printf ("usage: synbench [CHILDREN] [ROUNDS]\n");
+      return EXIT_FAILURE;
+    }
+
+  /* create() leaves the file sparse, so allocate every chunk up
+     front; the benchmark then measures writing rather than growth. */
+  if (!create (file_name, CHUNK_SIZE * child_cnt))
+    {
+      printf ("%s: create failed\n", file_name);
+      return EXIT_FAILURE;
+    }
+  fd = open (file_name);
+  if (fd < 0 || !fallocate (fd, CHUNK_SIZE * child_cnt, 0))
+    {
+      printf ("%s: fallocate failed\n", file_name);
+      return EXIT_FAILURE;
+    }
+  close (fd);
+
+  for (i = 0; i < child_cnt; i++)
+    {
+      snprintf (cmd, sizeof cmd, "synbench child %d %d", i, rounds);
+      children[i] = exec (cmd);
+      if (children[i] == PID_ERROR)
+        {
+          printf ("synbench: exec child %d failed\n", i);
+          return EXIT_FAILURE;
+        }
+    }
+  for (i = 0; i < child_cnt; i++)
+    if (wait (children[i]) != EXIT_SUCCESS)
+      failed++;
+
+  fd = open (file_name);
+  if (fd < 0)
+    {
+      printf ("%s: open failed\n", file_name);
+      return EXIT_FAILURE;
+    }
+  for (i = 0; i < child_cnt; i++)
+    {
+      fill (i, rounds - 1);
+      memcpy (expected, buf, CHUNK_SIZE);
+      if (read (fd, buf, CHUNK_SIZE) != CHUNK_SIZE
+          || memcmp (buf, expected, CHUNK_SIZE))
+        {
+          printf ("synbench: chunk %d has wrong contents\n", i);
+          failed++;
+        }
+    }
+  close (fd);
+
+  printf ("synbench: %d children, %d rounds of %d bytes, %d failures\n",
+          child_cnt, rounds, CHUNK_SIZE, failed);
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
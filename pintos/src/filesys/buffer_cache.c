@@ -1,27 +1,230 @@
 //////////////////////////////// PJ4 EDITED /////////////////////////////////
 #include "filesys/buffer_cache.h"
 #include <debug.h>
+#include <round.h>
+#include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
+#include "devices/timer.h"
 #include "filesys/filesys.h"
+#include "filesys/journal.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
-#define BUFFER_CACHE_ENTRY_NB 64
-uint8_t p_buffer_cache[BUFFER_CACHE_ENTRY_NB][BLOCK_SECTOR_SIZE]; /* entire buffer cache (32KByte). */
-struct buffer_head buffer_head[BUFFER_CACHE_ENTRY_NB]; /* Array of buffer head. */
-int clock_hand = 0; /* Clock hand for clock algorithm. */
+#define BUFFER_CACHE_ENTRY_NB 64        /* Default number of entries. */
+#define BC_SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
+#define BC_FLUSH_BATCH 64               /* Entries sorted per write back. */
+#define BC_FLUSH_POLL_TICKS 5           /* Flusher checks dirty ratio. */
+#define BC_RA_QUEUE_SIZE 64             /* Pending read-ahead requests. */
+
+/* How bc_get_entry() fills an entry on a cache miss. */
+enum bc_fill
+{
+  BC_FILL_READ,               /* Read sector from disk. */
+  BC_FILL_PREFETCH,           /* Read ahead; give up instead of waiting. */
+  BC_FILL_NONE                /* Caller overwrites the whole sector. */
+};
+
+/* A list of buffer heads or ghosts, with its length. */
+struct bc_queue
+{
+  struct list list;           /* Least recently used first. */
+  size_t cnt;                 /* Number of elements. */
+};
+
+/* A sector evicted recently, remembered without its data so a
+   replacement policy can tell a sector that comes back soon. */
+struct bc_ghost
+{
+  block_sector_t sector;      /* Evicted sector. */
+  struct bc_queue *queue;     /* Ghost queue holding it. */
+  struct hash_elem hash_elem; /* Element for bc_ghosts. */
+  struct list_elem elem;      /* Element for queue. */
+};
+
+/* Buffer cache replacement policy. Every function is called with
+   bc_lock held, and only for entries holding a sector. */
+struct bc_policy
+{
+  const char *name;           /* Name for -bcpolicy option. */
+  void (*insert) (struct buffer_head *);  /* Entry got a new sector. */
+  void (*touch) (struct buffer_head *);   /* Cache hit on entry. */
+  void (*remove) (struct buffer_head *, bool evicted); /* Entry
+                                                          dropped. */
+  struct buffer_head *(*select_victim) (block_sector_t sector,
+                                        bool allow_dirty);
+};
+
+/* A page of buffer cache and the buffer heads mapping it. */
+struct bc_page
+{
+  void *kaddr;                /* Page holding the cached sectors. */
+  bool borrowed;              /* Taken from user pool under dynamic mode. */
+  struct list_elem elem;      /* Element for bc_pages. */
+  struct buffer_head heads[BC_SECTORS_PER_PAGE];
+};
+
+static size_t bc_entry_nb = BUFFER_CACHE_ENTRY_NB;  /* Entries at boot. */
+static size_t bc_max_entry_nb = BUFFER_CACHE_ENTRY_NB; /* Growth limit. */
+static size_t bc_cur_entry_nb;    /* Entries currently allocated. */
+static int bc_dirty_cnt;          /* Entries with dirty data. */
+
+static int64_t bc_flush_interval = TIMER_FREQ; /* Ticks between flushes. */
+static int bc_dirty_ratio = 25;   /* Percent of dirty entries that wakes
+                                     flusher before its interval. */
+static bool bc_flush_wanted;      /* Victim search found only dirty. */
+
+/* Sectors queued for read-ahead thread. */
+static block_sector_t bc_ra_queue[BC_RA_QUEUE_SIZE];
+static size_t bc_ra_head, bc_ra_tail;  /* Pop at head, push at tail. */
+static struct lock bc_ra_lock;         /* Protects read-ahead queue. */
+static struct condition bc_ra_cond;    /* Signaled on push. */
+
+static struct cache_stats bc_stats; /* Counters, protected by bc_lock. */
+
+static struct list bc_pages;      /* All pages of buffer cache. */
+static struct list bc_list;       /* All buffer heads, in clock order. */
+static struct list_elem *bc_clock; /* Clock hand for clock algorithm. */
+static struct hash bc_index;      /* Sector number -> buffer head. */
+static struct list bc_free_list;  /* Buffer heads holding no sector. */
+static struct lock bc_lock;       /* Protects everything above and pins. */
+
+/* Replacement policy state, also protected by bc_lock. */
+static const struct bc_policy *bc_policy;
+static struct bc_queue bc_recent;         /* 2Q A1in, ARC T1. */
+static struct bc_queue bc_frequent;       /* 2Q Am, ARC T2. */
+static struct bc_queue bc_ghost_recent;   /* 2Q A1out, ARC B1. */
+static struct bc_queue bc_ghost_frequent; /* ARC B2. */
+static struct hash bc_ghosts;             /* Sector -> ghost. */
+static size_t bc_arc_target;              /* ARC target size of T1. */
+
+static unsigned bc_hash_func (const struct hash_elem *e, void *aux);
+static bool bc_less_func (const struct hash_elem *a,
+                          const struct hash_elem *b, void *aux);
+static bool bc_add_page (enum palloc_flags flags);
+static void bc_remove_page (struct bc_page *page);
+static struct buffer_head *bc_lookup (block_sector_t sector);
+static unsigned bc_ghost_hash_func (const struct hash_elem *e, void *aux);
+static bool bc_ghost_less_func (const struct hash_elem *a,
+                                const struct hash_elem *b, void *aux);
+static void clock_insert (struct buffer_head *bh);
+static void clock_touch (struct buffer_head *bh);
+static void clock_remove (struct buffer_head *bh, bool evicted);
+static struct buffer_head *clock_select_victim (block_sector_t sector,
+                                                bool allow_dirty);
+static void twoq_insert (struct buffer_head *bh);
+static void twoq_touch (struct buffer_head *bh);
+static void twoq_remove (struct buffer_head *bh, bool evicted);
+static struct buffer_head *twoq_select_victim (block_sector_t sector,
+                                               bool allow_dirty);
+static void arc_insert (struct buffer_head *bh);
+static void arc_touch (struct buffer_head *bh);
+static void arc_remove (struct buffer_head *bh, bool evicted);
+static struct buffer_head *arc_select_victim (block_sector_t sector,
+                                              bool allow_dirty);
+static struct buffer_head *bc_select_victim (block_sector_t sector);
+static void bc_acquire (void);
+static struct buffer_head *bc_get_entry (block_sector_t sector,
+                                         enum bc_fill fill,
+                                         enum cache_class class);
+static void bc_put_entry (struct buffer_head *bh, bool dirty);
+static void bc_unpin (struct buffer_head *bh);
+static bool bc_over_dirty_ratio (void);
+static int bc_sector_cmp (const void *a, const void *b);
+static void bc_flusher (void *aux);
+static void bc_read_ahead_daemon (void *aux);
+
+/* Replacement policies selectable by bc_configure_policy(). */
+static const struct bc_policy bc_policies[] =
+{
+  {"clock", clock_insert, clock_touch, clock_remove, clock_select_victim},
+  {"2q", twoq_insert, twoq_touch, twoq_remove, twoq_select_victim},
+  {"arc", arc_insert, arc_touch, arc_remove, arc_select_victim},
+};
+
+static const struct bc_policy *bc_policy = &bc_policies[0];
+
+/* Set number of buffer cache entries allocated at boot to
+   ENTRY_NB, or keep the default if ENTRY_NB is 0. If MAX_ENTRY_NB
+   is larger, the buffer cache may borrow pages from user pool up
+   to MAX_ENTRY_NB entries and give them back to frame allocator
+   under memory pressure. Must be called before bc_init(). */
+void
+bc_configure (size_t entry_nb, size_t max_entry_nb)
+{
+  if (entry_nb > 0)
+    bc_entry_nb = ROUND_UP (entry_nb, BC_SECTORS_PER_PAGE);
+  bc_max_entry_nb = max_entry_nb > bc_entry_nb ? max_entry_nb : bc_entry_nb;
+}
+
+/* Set flusher to write back dirty entries every INTERVAL_MS
+   milliseconds, or earlier once DIRTY_RATIO percent of entries
+   are dirty. 0 keeps the default. Must be called before
+   bc_init(). */
+void
+bc_configure_flusher (int interval_ms, int dirty_ratio)
+{
+  if (interval_ms > 0)
+    bc_flush_interval = DIV_ROUND_UP ((int64_t) interval_ms * TIMER_FREQ,
+                                      1000);
+  if (dirty_ratio > 0 && dirty_ratio <= 100)
+    bc_dirty_ratio = dirty_ratio;
+}
+
+/* Select buffer cache replacement policy NAME, one of "clock",
+   "2q" and "arc". Return false if NAME is unknown. Must be called
+   before bc_init(). */
+bool
+bc_configure_policy (const char *name)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof bc_policies / sizeof *bc_policies; i++)
+    if (!strcmp (name, bc_policies[i].name))
+    {
+      bc_policy = &bc_policies[i];
+      return true;
+    }
+
+  return false;
+}
 
 /* Initialize buffer cache. */
 void
 bc_init (void)
 {
-  int i;
+  hash_init (&bc_index, bc_hash_func, bc_less_func, NULL);
+  list_init (&bc_pages);
+  list_init (&bc_list);
+  list_init (&bc_free_list);
+  lock_init (&bc_lock);
+  bc_clock = NULL;
+  list_init (&bc_recent.list);
+  list_init (&bc_frequent.list);
+  list_init (&bc_ghost_recent.list);
+  list_init (&bc_ghost_frequent.list);
+  bc_recent.cnt = bc_frequent.cnt = 0;
+  bc_ghost_recent.cnt = bc_ghost_frequent.cnt = 0;
+  hash_init (&bc_ghosts, bc_ghost_hash_func, bc_ghost_less_func, NULL);
+  bc_arc_target = 0;
+  bc_cur_entry_nb = 0;
+  bc_dirty_cnt = 0;
+  bc_flush_wanted = false;
+  lock_init (&bc_ra_lock);
+  cond_init (&bc_ra_cond);
+  bc_ra_head = bc_ra_tail = 0;
+  memset (&bc_stats, 0, sizeof bc_stats);
 
-  memset (buffer_head, 0, sizeof (struct buffer_head) * BUFFER_CACHE_ENTRY_NB);
-  memset (p_buffer_cache, -1, BUFFER_CACHE_ENTRY_NB * BLOCK_SECTOR_SIZE);
-  for (i = 0; i < BUFFER_CACHE_ENTRY_NB; i++)
-  {
-    lock_init (&buffer_head[i].buffer_lock);
-    buffer_head[i].data = p_buffer_cache[i];
-  }
+  lock_acquire (&bc_lock);
+  while (bc_cur_entry_nb < bc_entry_nb)
+    if (!bc_add_page (0))
+      PANIC ("buffer cache: can't allocate %zu entries", bc_entry_nb);
+  lock_release (&bc_lock);
+
+  thread_create ("bc_flusher", PRI_DEFAULT, bc_flusher, NULL);
+  thread_create ("bc_read_ahead", PRI_DEFAULT, bc_read_ahead_daemon, NULL);
 }
 
 /* Remove buffer cache. Just flush all entries. */
@@ -31,142 +234,900 @@ bc_term (void)
   bc_flush_all_entries ();
 }
 
-/* Select victim entry by clock algorithm. Return victim. */
-struct buffer_head *
-bc_select_victim (void)
+/* Hash function for sector index. */
+static unsigned
+bc_hash_func (const struct hash_elem *e, void *aux UNUSED)
 {
-  struct buffer_head *victim;
+  return hash_int (hash_entry (e, struct buffer_head, hash_elem)->sector);
+}
 
-  while (true)
+/* Compare function for sector index. */
+static bool
+bc_less_func (const struct hash_elem *a, const struct hash_elem *b,
+              void *aux UNUSED)
+{
+  return hash_entry (a, struct buffer_head, hash_elem)->sector
+         < hash_entry (b, struct buffer_head, hash_elem)->sector;
+}
+
+/* Allocate a page with FLAGS and add its buffer heads to free
+   list. Return true if success, false otherwise.
+   Caller must hold bc_lock. */
+static bool
+bc_add_page (enum palloc_flags flags)
+{
+  struct bc_page *page;
+  int i;
+
+  ASSERT (lock_held_by_current_thread (&bc_lock));
+  page = malloc (sizeof *page);
+  if (page == NULL)
+    return false;
+  page->kaddr = palloc_get_page (flags);
+  if (page->kaddr == NULL)
+  {
+    free (page);
+    return false;
+  }
+  page->borrowed = (flags & PAL_USER) != 0;
+
+  memset (page->heads, 0, sizeof page->heads);
+  for (i = 0; i < BC_SECTORS_PER_PAGE; i++)
+  {
+    struct buffer_head *bh = &page->heads[i];
+
+    lock_init (&bh->buffer_lock);
+    bh->data = page->kaddr + i * BLOCK_SECTOR_SIZE;
+    list_push_back (&bc_list, &bh->clock_elem);
+    list_push_back (&bc_free_list, &bh->free_elem);
+  }
+  list_push_back (&bc_pages, &page->elem);
+  bc_cur_entry_nb += BC_SECTORS_PER_PAGE;
+
+  return true;
+}
+
+/* Unlink every buffer head of PAGE and PAGE itself.
+   Every head must be unpinned and clean. The caller frees the
+   page memory after releasing bc_lock. */
+static void
+bc_remove_page (struct bc_page *page)
+{
+  int i;
+
+  ASSERT (lock_held_by_current_thread (&bc_lock));
+  for (i = 0; i < BC_SECTORS_PER_PAGE; i++)
+  {
+    struct buffer_head *bh = &page->heads[i];
+
+    ASSERT (bh->pin_cnt == 0 && !bh->dirty);
+    if (bh->prefetched)
+      bc_stats.ra_wasted++;
+    if (bh->in_use)
+    {
+      bc_policy->remove (bh, false);
+      hash_delete (&bc_index, &bh->hash_elem);
+    }
+    else
+      list_remove (&bh->free_elem);
+    if (bc_clock == &bh->clock_elem)
+      bc_clock = list_next (bc_clock);
+    list_remove (&bh->clock_elem);
+  }
+  list_remove (&page->elem);
+  bc_cur_entry_nb -= BC_SECTORS_PER_PAGE;
+}
+
+/* Give one borrowed page back to user pool. Called by frame
+   allocator before it evicts user pages. Dirty sectors on that
+   page are written back first. Return true if a page was freed. */
+bool
+bc_shrink (void)
+{
+  struct list_elem *e;
+
+  lock_acquire (&bc_lock);
+  for (e = list_rbegin (&bc_pages); e != list_rend (&bc_pages);
+       e = list_prev (e))
+  {
+    struct bc_page *page = list_entry (e, struct bc_page, elem);
+    void *kaddr = page->kaddr;
+    bool busy = false;
+    int i;
+
+    if (!page->borrowed)
+      continue;
+    for (i = 0; i < BC_SECTORS_PER_PAGE; i++)
+      busy = busy || page->heads[i].pin_cnt > 0;
+    if (busy)
+      continue;
+
+    /* Pin heads so nobody recycles them during write back. */
+    for (i = 0; i < BC_SECTORS_PER_PAGE; i++)
+      page->heads[i].pin_cnt++;
+    lock_release (&bc_lock);
+    for (i = 0; i < BC_SECTORS_PER_PAGE; i++)
+      if (page->heads[i].in_use)
+        bc_flush_entry (&page->heads[i]);
+    lock_acquire (&bc_lock);
+    for (i = 0; i < BC_SECTORS_PER_PAGE; i++)
+    {
+      page->heads[i].pin_cnt--;
+      busy = busy || page->heads[i].pin_cnt > 0 || page->heads[i].dirty;
+    }
+    if (busy)
+      continue;
+
+    bc_remove_page (page);
+    lock_release (&bc_lock);
+    palloc_free_page (kaddr);
+    free (page);
+    return true;
+  }
+  lock_release (&bc_lock);
+
+  return false;
+}
+
+/* Return true if BH may be evicted now. Dirty entries are taken
+   only if ALLOW_DIRTY. */
+static bool
+bc_evictable (const struct buffer_head *bh, bool allow_dirty)
+{
+  return bh->pin_cnt == 0 && (allow_dirty || !bh->dirty);
+}
+
+/* Append ELEM to Q. */
+static void
+bc_queue_push (struct bc_queue *q, struct list_elem *elem)
+{
+  list_push_back (&q->list, elem);
+  q->cnt++;
+}
+
+/* Remove ELEM from Q. */
+static void
+bc_queue_remove (struct bc_queue *q, struct list_elem *elem)
+{
+  ASSERT (q->cnt > 0);
+  list_remove (elem);
+  q->cnt--;
+}
+
+/* Move resident BH to queue Q, at its most recently used end. */
+static void
+bc_queue_move (struct buffer_head *bh, struct bc_queue *q)
+{
+  if (bh->queue != NULL)
+    bc_queue_remove (bh->queue, &bh->queue_elem);
+  bh->queue = q;
+  bc_queue_push (q, &bh->queue_elem);
+}
+
+/* Return the least recently used evictable entry of resident
+   queue Q, or NULL if none. */
+static struct buffer_head *
+bc_queue_scan (struct bc_queue *q, bool allow_dirty)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&q->list); e != list_end (&q->list); e = list_next (e))
   {
-    struct buffer_head *cp = &buffer_head[clock_hand % BUFFER_CACHE_ENTRY_NB];
+    struct buffer_head *bh = list_entry (e, struct buffer_head, queue_elem);
+
+    if (bc_evictable (bh, allow_dirty))
+      return bh;
+  }
+
+  return NULL;
+}
+
+/* Hash function for ghost index. */
+static unsigned
+bc_ghost_hash_func (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct bc_ghost, hash_elem)->sector);
+}
+
+/* Compare function for ghost index. */
+static bool
+bc_ghost_less_func (const struct hash_elem *a, const struct hash_elem *b,
+                    void *aux UNUSED)
+{
+  return hash_entry (a, struct bc_ghost, hash_elem)->sector
+         < hash_entry (b, struct bc_ghost, hash_elem)->sector;
+}
+
+/* Return ghost of SECTOR, or NULL if SECTOR was not evicted
+   recently. */
+static struct bc_ghost *
+bc_ghost_find (block_sector_t sector)
+{
+  struct bc_ghost key;
+  struct hash_elem *e;
+
+  key.sector = sector;
+  e = hash_find (&bc_ghosts, &key.hash_elem);
+
+  return e != NULL ? hash_entry (e, struct bc_ghost, hash_elem) : NULL;
+}
+
+/* Remember that SECTOR was just evicted, in ghost queue Q.
+   A ghost holds no data, so losing one to a failed malloc() only
+   makes the policy forget some history. */
+static void
+bc_ghost_add (block_sector_t sector, struct bc_queue *q)
+{
+  struct bc_ghost *g = bc_ghost_find (sector);
+
+  if (g != NULL)
+    bc_queue_remove (g->queue, &g->elem);
+  else
+  {
+    g = malloc (sizeof *g);
+    if (g == NULL)
+      return;
+    g->sector = sector;
+    hash_insert (&bc_ghosts, &g->hash_elem);
+  }
+  g->queue = q;
+  bc_queue_push (q, &g->elem);
+}
+
+/* Forget ghost G. */
+static void
+bc_ghost_remove (struct bc_ghost *g)
+{
+  bc_queue_remove (g->queue, &g->elem);
+  hash_delete (&bc_ghosts, &g->hash_elem);
+  free (g);
+}
+
+/* Forget the oldest ghosts of Q until it holds at most MAX. */
+static void
+bc_ghost_trim (struct bc_queue *q, size_t max)
+{
+  while (q->cnt > max)
+    bc_ghost_remove (list_entry (list_front (&q->list),
+                                 struct bc_ghost, elem));
+}
+
+/* Clock: entries are kept in bc_list and the accessed bit gives
+   each one a second chance. */
+static void
+clock_insert (struct buffer_head *bh)
+{
+  bh->accessed = true;
+}
+
+static void
+clock_touch (struct buffer_head *bh)
+{
+  bh->accessed = true;
+}
+
+static void
+clock_remove (struct buffer_head *bh UNUSED, bool evicted UNUSED)
+{
+}
+
+/* Sweep clock hand at most twice around bc_list. */
+static struct buffer_head *
+clock_select_victim (block_sector_t sector UNUSED, bool allow_dirty)
+{
+  size_t i;
+
+  for (i = 0; i < 2 * bc_cur_entry_nb; i++)
+  {
+    struct buffer_head *cp;
+
+    if (bc_clock == NULL || bc_clock == list_end (&bc_list))
+      bc_clock = list_begin (&bc_list);
+    cp = list_entry (bc_clock, struct buffer_head, clock_elem);
+    bc_clock = list_next (bc_clock);
 
-    lock_acquire (&cp->buffer_lock);
     ASSERT (cp->in_use);
+    if (cp->pin_cnt > 0)
+      continue;
     if (cp->accessed)
       cp->accessed = false;
-    else
+    else if (bc_evictable (cp, allow_dirty))
+      return cp;
+  }
+
+  return NULL;
+}
+
+/* 2Q: a sector first enters bc_recent (A1in), a FIFO holding
+   about a quarter of the cache, and further hits there don't
+   promote it, so one pass of a streaming reader flows through
+   without disturbing the rest. Sectors evicted from A1in are
+   remembered in bc_ghost_recent (A1out); only a sector missed
+   again while still remembered enters bc_frequent (Am), an LRU
+   list holding the hot set. */
+static void
+twoq_insert (struct buffer_head *bh)
+{
+  struct bc_ghost *g = bc_ghost_find (bh->sector);
+
+  if (g != NULL)
+  {
+    bc_ghost_remove (g);
+    bc_queue_move (bh, &bc_frequent);
+  }
+  else
+    bc_queue_move (bh, &bc_recent);
+}
+
+static void
+twoq_touch (struct buffer_head *bh)
+{
+  if (bh->queue == &bc_frequent)
+    bc_queue_move (bh, &bc_frequent);
+}
+
+static void
+twoq_remove (struct buffer_head *bh, bool evicted)
+{
+  struct bc_queue *q = bh->queue;
+
+  bc_queue_remove (q, &bh->queue_elem);
+  bh->queue = NULL;
+  if (evicted && q == &bc_recent)
+  {
+    bc_ghost_add (bh->sector, &bc_ghost_recent);
+    bc_ghost_trim (&bc_ghost_recent, bc_cur_entry_nb / 2);
+  }
+}
+
+static struct buffer_head *
+twoq_select_victim (block_sector_t sector UNUSED, bool allow_dirty)
+{
+  struct buffer_head *bh;
+
+  if (bc_recent.cnt > bc_cur_entry_nb / 4)
+  {
+    bh = bc_queue_scan (&bc_recent, allow_dirty);
+    return bh != NULL ? bh : bc_queue_scan (&bc_frequent, allow_dirty);
+  }
+  bh = bc_queue_scan (&bc_frequent, allow_dirty);
+  return bh != NULL ? bh : bc_queue_scan (&bc_recent, allow_dirty);
+}
+
+/* ARC: bc_recent (T1) holds sectors referenced once and
+   bc_frequent (T2) sectors referenced again, each backed by a
+   ghost queue of its recent evictions (B1, B2). A miss that hits
+   a ghost moves bc_arc_target, the preferred size of T1, toward
+   the side that would have kept the sector. The first use of a
+   read-ahead sector counts as its first reference. */
+static void
+arc_insert (struct buffer_head *bh)
+{
+  struct bc_ghost *g = bc_ghost_find (bh->sector);
+  size_t c = bc_cur_entry_nb;
+  size_t b1 = bc_ghost_recent.cnt, b2 = bc_ghost_frequent.cnt;
+
+  if (g == NULL)
+  {
+    bc_queue_move (bh, &bc_recent);
+    if (bc_recent.cnt + b1 > c)
+      bc_ghost_trim (&bc_ghost_recent,
+                     c > bc_recent.cnt ? c - bc_recent.cnt : 0);
+    else if (b2 > 0 && bc_recent.cnt + bc_frequent.cnt + b1 + b2 > 2 * c)
+      bc_ghost_trim (&bc_ghost_frequent, b2 - 1);
+    return;
+  }
+
+  if (g->queue == &bc_ghost_recent)
+  {
+    size_t delta = b2 > b1 ? b2 / b1 : 1;
+
+    bc_arc_target = bc_arc_target + delta < c ? bc_arc_target + delta : c;
+  }
+  else
+  {
+    size_t delta = b1 > b2 ? b1 / b2 : 1;
+
+    bc_arc_target = bc_arc_target > delta ? bc_arc_target - delta : 0;
+  }
+  bc_ghost_remove (g);
+  bc_queue_move (bh, &bc_frequent);
+}
+
+static void
+arc_touch (struct buffer_head *bh)
+{
+  if (!bh->prefetched)
+    bc_queue_move (bh, &bc_frequent);
+}
+
+static void
+arc_remove (struct buffer_head *bh, bool evicted)
+{
+  struct bc_queue *q = bh->queue;
+
+  bc_queue_remove (q, &bh->queue_elem);
+  bh->queue = NULL;
+  if (evicted)
+  {
+    struct bc_queue *ghost = q == &bc_recent ? &bc_ghost_recent
+                                             : &bc_ghost_frequent;
+
+    bc_ghost_add (bh->sector, ghost);
+    bc_ghost_trim (ghost, bc_cur_entry_nb);
+  }
+}
+
+static struct buffer_head *
+arc_select_victim (block_sector_t sector, bool allow_dirty)
+{
+  struct bc_ghost *g = bc_ghost_find (sector);
+  struct buffer_head *bh;
+
+  if (bc_recent.cnt > 0
+      && (bc_recent.cnt > bc_arc_target
+          || (g != NULL && g->queue == &bc_ghost_frequent
+              && bc_recent.cnt == bc_arc_target)))
+  {
+    bh = bc_queue_scan (&bc_recent, allow_dirty);
+    return bh != NULL ? bh : bc_queue_scan (&bc_frequent, allow_dirty);
+  }
+  bh = bc_queue_scan (&bc_frequent, allow_dirty);
+  return bh != NULL ? bh : bc_queue_scan (&bc_recent, allow_dirty);
+}
+
+/* Select victim entry by replacement policy. Pinned entries are
+   skipped, and dirty entries are skipped on the first try so that
+   the caller rarely waits on a write back; flusher is woken up
+   instead. SECTOR is the sector about to be cached. Return victim,
+   or NULL if every entry is pinned. Caller must hold bc_lock. */
+static struct buffer_head *
+bc_select_victim (block_sector_t sector)
+{
+  struct buffer_head *bh;
+
+  ASSERT (lock_held_by_current_thread (&bc_lock));
+  bh = bc_policy->select_victim (sector, false);
+  if (bh == NULL)
+  {
+    if (bc_dirty_cnt > 0)
+      bc_flush_wanted = true;
+    bh = bc_policy->select_victim (sector, true);
+  }
+
+  return bh;
+}
+
+/* Lookup sector index for given sector number.
+   Return pointer if found, return NULL otherwise.
+   Caller must hold bc_lock. */
+static struct buffer_head *
+bc_lookup (block_sector_t sector)
+{
+  struct buffer_head key;
+  struct hash_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&bc_lock));
+  key.sector = sector;
+  e = hash_find (&bc_index, &key.hash_elem);
+
+  return e != NULL ? hash_entry (e, struct buffer_head, hash_elem) : NULL;
+}
+
+/* Acquire bc_lock, counting the times it was contended. */
+static void
+bc_acquire (void)
+{
+  if (!lock_try_acquire (&bc_lock))
+  {
+    lock_acquire (&bc_lock);
+    bc_stats.lock_waits++;
+  }
+}
+
+/* Drop a pin taken under bc_lock. */
+static void
+bc_unpin (struct buffer_head *bh)
+{
+  bc_acquire ();
+  ASSERT (bh->pin_cnt > 0);
+  bh->pin_cnt--;
+  lock_release (&bc_lock);
+}
+
+/* Return pinned and locked buffer head holding SECTOR.
+   If SECTOR is not cached, then take a free entry, a newly
+   borrowed page, or a victim and read SECTOR from disk into it.
+   A dirty victim is written back while it is still indexed under
+   its old sector, so no reader can see stale disk contents in
+   the meantime.
+   FILL tells how to fill the entry on a miss. With
+   BC_FILL_PREFETCH, return NULL instead of waiting when SECTOR is
+   already cached or no clean victim is available. With
+   BC_FILL_NONE, the disk read is skipped and the caller must
+   overwrite the whole sector before releasing it. A sector is
+   read through the journal, which may hold a copy newer than disk.
+   CLASS is the kind of SECTOR, for statistics and for telling
+   metadata to bc_put_entry(). */
+static struct buffer_head *
+bc_get_entry (block_sector_t sector, enum bc_fill fill,
+              enum cache_class class)
+{
+  struct buffer_head *bh;
+  bool prefetch = fill == BC_FILL_PREFETCH;
+
+  while (true)
+  {
+    bc_acquire ();
+    bh = bc_lookup (sector);
+    if (bh != NULL) /* Cache hit! */
     {
-      victim = cp;
-      clock_hand++;
-      if (victim->dirty)
+      if (prefetch)
       {
-        lock_release (&victim->buffer_lock);
-        bc_flush_entry (victim);
-        lock_acquire (&victim->buffer_lock);
+        lock_release (&bc_lock);
+        return NULL;
       }
-      lock_release (&victim->buffer_lock);
-      break;
+      bc_policy->touch (bh);
+      if (bh->prefetched)
+      {
+        bh->prefetched = false;
+        bc_stats.ra_hits++;
+      }
+      bh->pin_cnt++;
+      bc_stats.hits++;
+      bc_stats.class_hits[class]++;
+      if (lock_try_acquire (&bh->buffer_lock))
+        lock_release (&bc_lock);
+      else
+      {
+        bc_stats.lock_waits++;
+        lock_release (&bc_lock);
+        lock_acquire (&bh->buffer_lock);
+      }
+      bh->class = class;
+      return bh;
     }
-    lock_release (&cp->buffer_lock);
-    clock_hand++;
-  }
 
-  return victim;
+    /* Cache miss! Grow instead of evicting if memory is free. */
+    if (list_empty (&bc_free_list)
+        && bc_cur_entry_nb + BC_SECTORS_PER_PAGE <= bc_max_entry_nb)
+      bc_add_page (PAL_USER);
+
+    if (!list_empty (&bc_free_list)) /* Buffer cache is not full! */
+      bh = list_entry (list_pop_front (&bc_free_list),
+                       struct buffer_head, free_elem);
+    else /* Buffer cache is full! */
+    {
+      bh = bc_select_victim (sector);
+      if (prefetch && (bh == NULL || bh->dirty))
+      {
+        if (bc_dirty_cnt > 0)
+          bc_flush_wanted = true;
+        lock_release (&bc_lock);
+        return NULL;
+      }
+      if (bh == NULL)
+      {
+        lock_release (&bc_lock);
+        thread_yield ();
+        continue;
+      }
+      if (bh->dirty)
+      {
+        bh->pin_cnt++;
+        lock_release (&bc_lock);
+        bc_flush_entry (bh);
+        bc_unpin (bh);
+        continue;
+      }
+      bc_policy->remove (bh, true);
+      hash_delete (&bc_index, &bh->hash_elem);
+      bc_stats.evictions++;
+      if (bh->prefetched)
+        bc_stats.ra_wasted++;
+    }
+
+    /* Nobody holds the lock of an unpinned entry, so this
+       never blocks. Concurrent lookups of SECTOR wait on it
+       until the disk read below completes. */
+    bh->sector = sector;
+    bh->in_use = true;
+    bh->dirty = false;
+    bh->prefetched = prefetch;
+    bh->pin_cnt++;
+    if (prefetch)
+      bc_stats.ra_reads++;
+    else
+    {
+      bc_stats.misses++;
+      bc_stats.class_misses[class]++;
+    }
+    hash_insert (&bc_index, &bh->hash_elem);
+    bc_policy->insert (bh);
+    lock_acquire (&bh->buffer_lock);
+    bh->class = class;
+    lock_release (&bc_lock);
+
+    if (fill != BC_FILL_NONE)
+      journal_read (sector, bh->data);
+    return bh;
+  }
 }
 
-/* Lookup buffer head array and compare sector number of cache
-   to given sector. Return pointer if found, return NULL otherwise. */
-struct buffer_head *
-bc_lookup (block_sector_t sector)
+/* Unlock and unpin buffer head returned by bc_get_entry().
+   If DIRTY, mark the entry dirty first. Modified metadata is
+   copied into the journal instead and the entry stays clean,
+   since only the journal may write metadata home. */
+static void
+bc_put_entry (struct buffer_head *bh, bool dirty)
 {
-  int i;
+  bool newly_dirty = false;
+  bool newly_clean = false;
 
-  for (i = 0; i < BUFFER_CACHE_ENTRY_NB; i++)
-    if (buffer_head[i].in_use && buffer_head[i].sector == sector)
-      return &buffer_head[i];
+  if (dirty && bh->class != CACHE_DATA
+      && journal_log (bh->sector, bh->data))
+  {
+    newly_clean = bh->dirty;
+    bh->dirty = false;
+  }
+  else if (dirty && !bh->dirty)
+  {
+    newly_dirty = true;
+    bh->dirty = true;
+  }
+  lock_release (&bh->buffer_lock);
 
-  return NULL;
+  bc_acquire ();
+  ASSERT (bh->pin_cnt > 0);
+  bh->pin_cnt--;
+  if (newly_dirty)
+    bc_dirty_cnt++;
+  if (newly_clean)
+    bc_dirty_cnt--;
+  lock_release (&bc_lock);
 }
 
-/* Flush given buffer cache entry by calling block_write() */
+/* Flush given buffer cache entry by calling block_write().
+   Caller must have the entry pinned. */
 void
 bc_flush_entry (struct buffer_head *p_flush_entry)
 {
+  bool written = false;
+
   lock_acquire (&p_flush_entry->buffer_lock);
-  ASSERT (p_flush_entry->in_use && p_flush_entry->dirty);
-  block_write (fs_device, p_flush_entry->sector, p_flush_entry->data);
-  p_flush_entry->dirty = false;
+  ASSERT (p_flush_entry->in_use);
+  if (p_flush_entry->dirty)
+  {
+    block_write (fs_device, p_flush_entry->sector, p_flush_entry->data);
+    p_flush_entry->dirty = false;
+    written = true;
+  }
   lock_release (&p_flush_entry->buffer_lock);
+
+  if (written)
+  {
+    bc_acquire ();
+    bc_dirty_cnt--;
+    bc_stats.write_backs++;
+    lock_release (&bc_lock);
+  }
 }
 
-/* Flush entire buffer cache by calling bc_flush_entry() repeatedly. */
+/* Compare sector numbers of two buffer heads for qsort(). */
+static int
+bc_sector_cmp (const void *a, const void *b)
+{
+  const struct buffer_head *bh_a = *(struct buffer_head * const *) a;
+  const struct buffer_head *bh_b = *(struct buffer_head * const *) b;
+
+  return bh_a->sector < bh_b->sector ? -1 : bh_a->sector > bh_b->sector;
+}
+
+/* Flush entire buffer cache. Dirty entries are collected
+   BC_FLUSH_BATCH at a time and written back in sector order. */
 void
 bc_flush_all_entries (void)
 {
-  int i;
+  struct buffer_head *batch[BC_FLUSH_BATCH];
+  struct list_elem *e;
+
+  lock_acquire (&bc_lock);
+  e = list_begin (&bc_list);
+  while (e != list_end (&bc_list))
+  {
+    size_t cnt = 0;
+    size_t i;
+
+    for (; e != list_end (&bc_list) && cnt < BC_FLUSH_BATCH; e = list_next (e))
+    {
+      struct buffer_head *bh = list_entry (e, struct buffer_head, clock_elem);
 
-  for (i = 0; i < BUFFER_CACHE_ENTRY_NB; i++)
-    if (buffer_head[i].in_use && buffer_head[i].dirty)
-      bc_flush_entry (&buffer_head[i]);
+      if (bh->in_use && bh->dirty)
+      {
+        bh->pin_cnt++;
+        batch[cnt++] = bh;
+      }
+    }
+    if (cnt == 0)
+      break;
+    lock_release (&bc_lock);
+
+    qsort (batch, cnt, sizeof *batch, bc_sector_cmp);
+    for (i = 0; i < cnt; i++)
+      bc_flush_entry (batch[i]);
+
+    /* Resume after the last pinned entry, which is still linked. */
+    lock_acquire (&bc_lock);
+    e = list_next (&batch[cnt - 1]->clock_elem);
+    for (i = 0; i < cnt; i++)
+      batch[i]->pin_cnt--;
+  }
+  lock_release (&bc_lock);
 }
 
-/* Read data from buffer cache. If buffer cache of sector_idx
-   doesn't exist, then select victim and write data from disk
-   to victim.*/
+/* Return true if flusher should run before its interval. */
+static bool
+bc_over_dirty_ratio (void)
+{
+  return bc_flush_wanted
+         || (size_t) bc_dirty_cnt * 100 >= bc_dirty_ratio * bc_cur_entry_nb;
+}
+
+/* Background thread that writes back dirty entries every
+   bc_flush_interval ticks, or as soon as too many entries are
+   dirty, so eviction seldom has to write back by itself. Each
+   round also commits the metadata journal, so operations of the
+   last interval share one log write. */
+static void
+bc_flusher (void *aux UNUSED)
+{
+  while (true)
+  {
+    int64_t start = timer_ticks ();
+
+    while (timer_elapsed (start) < bc_flush_interval && !bc_over_dirty_ratio ())
+      timer_sleep (BC_FLUSH_POLL_TICKS);
+
+    /* Take the request now, even if nothing turns out dirty, such
+       as when every entry is pinned; left set, it would never let
+       the flusher sleep. Requests made during the round start the
+       next one. */
+    lock_acquire (&bc_lock);
+    bc_flush_wanted = false;
+    lock_release (&bc_lock);
+    journal_commit ();
+    if (bc_dirty_cnt > 0)
+      bc_flush_all_entries ();
+  }
+}
+
+/* Return buffer head holding SECTOR of kind CLASS, pinned and
+   locked, so caller can access its data in place. Caller must not
+   hold any other buffer head of the same sector, and must call
+   bc_release() when done. */
+struct buffer_head *
+bc_get (block_sector_t sector, enum cache_class class)
+{
+  return bc_get_entry (sector, BC_FILL_READ, class);
+}
+
+/* Like bc_get(), but for a newly allocated SECTOR whose old
+   contents don't matter. Return it filled with zeros without
+   reading the disk; it reaches disk only on write back. */
+struct buffer_head *
+bc_get_new (block_sector_t sector, enum cache_class class)
+{
+  struct buffer_head *bh = bc_get_entry (sector, BC_FILL_NONE, class);
+
+  memset (bh->data, 0, BLOCK_SECTOR_SIZE);
+  return bh;
+}
+
+/* Release buffer head returned by bc_get(). DIRTY tells whether
+   caller modified its data. */
 void
-bc_read (block_sector_t sector_idx, void *buffer,
-         off_t bytes_read, int chunk_size, int sector_ofs)
+bc_release (struct buffer_head *bh, bool dirty)
 {
-  struct buffer_head *in_cache = bc_lookup (sector_idx);
+  bc_put_entry (bh, dirty);
+}
 
-  if (in_cache != NULL) /* Cache hit! */
-    lock_acquire (&in_cache->buffer_lock);
-  else /* Cache miss! */
+/* Queue SECTOR to be read into buffer cache by read-ahead
+   thread. The request is dropped if the queue is full. */
+void
+bc_read_ahead (block_sector_t sector)
+{
+  lock_acquire (&bc_ra_lock);
+  if (bc_ra_tail - bc_ra_head < BC_RA_QUEUE_SIZE)
   {
-    int idx;
+    bc_ra_queue[bc_ra_tail++ % BC_RA_QUEUE_SIZE] = sector;
+    cond_signal (&bc_ra_cond, &bc_ra_lock);
+  }
+  lock_release (&bc_ra_lock);
+}
 
-    for (idx = 0; idx < BUFFER_CACHE_ENTRY_NB; idx++)
-      if (!buffer_head[idx].in_use)
-        break;
+/* Background thread that reads queued sectors into buffer
+   cache before readers ask for them. */
+static void
+bc_read_ahead_daemon (void *aux UNUSED)
+{
+  while (true)
+  {
+    struct buffer_head *bh;
+    block_sector_t sector;
 
-    if (idx < BUFFER_CACHE_ENTRY_NB) /* Buffer cache is not full! */
-      in_cache = &buffer_head[idx]; /* Select empty entry. */
-    else /* Buffer cache is full! */
-      in_cache = bc_select_victim (); /* Select victim. */
+    lock_acquire (&bc_ra_lock);
+    while (bc_ra_head == bc_ra_tail)
+      cond_wait (&bc_ra_cond, &bc_ra_lock);
+    sector = bc_ra_queue[bc_ra_head++ % BC_RA_QUEUE_SIZE];
+    lock_release (&bc_ra_lock);
 
-    lock_acquire (&in_cache->buffer_lock);
-    block_read (fs_device, sector_idx, in_cache->data);
+    bh = bc_get_entry (sector, BC_FILL_PREFETCH, CACHE_DATA);
+    if (bh != NULL)
+      bc_put_entry (bh, false);
   }
+}
+
+/* Copy buffer cache and file system device statistics into
+   STATS. */
+void
+bc_get_stats (struct cache_stats *stats)
+{
+  bc_acquire ();
+  *stats = bc_stats;
+  stats->entry_cnt = bc_cur_entry_nb;
+  stats->dirty_cnt = bc_dirty_cnt;
+  lock_release (&bc_lock);
+  block_get_stats (fs_device, &stats->disk_reads, &stats->disk_writes);
+  block_get_seek_stats (fs_device, &stats->disk_seek_dist,
+                        &stats->disk_long_seeks);
+}
+
+/* Print buffer cache statistics. */
+void
+bc_print_stats (void)
+{
+  struct cache_stats s;
+
+  bc_get_stats (&s);
+  printf ("Buffer cache: %llu hits, %llu misses, %llu evictions, "
+          "%llu write backs, %llu lock waits\n",
+          s.hits, s.misses, s.evictions, s.write_backs, s.lock_waits);
+  printf ("Buffer cache: %llu sectors read ahead, %llu hits, %llu wasted\n",
+          s.ra_reads, s.ra_hits, s.ra_wasted);
+  printf ("Buffer cache: disk seeks skipped %llu sectors, %llu long seeks\n",
+          s.disk_seek_dist, s.disk_long_seeks);
+}
+
+/* Read data from buffer cache. If buffer cache of sector_idx
+   doesn't exist, then select victim and write data from disk
+   to victim. CLASS is CACHE_DATA or CACHE_METADATA.*/
+void
+bc_read (block_sector_t sector_idx, void *buffer,
+         off_t bytes_read, int chunk_size, int sector_ofs,
+         enum cache_class class)
+{
+  struct buffer_head *in_cache = bc_get_entry (sector_idx, BC_FILL_READ,
+                                               class);
+
   memcpy (buffer + bytes_read, in_cache->data + sector_ofs, chunk_size);
-  in_cache->in_use = true;
-  in_cache->accessed = true;
-  in_cache->sector = sector_idx;
-  lock_release (&in_cache->buffer_lock);
+  bc_put_entry (in_cache, false);
 }
 
 /* Write data to buffer cache. If buffer cache of sector_idx
    doesn't exist, then select victim, read from disk, and
-   write data to it.*/
+   write data to it. A write covering the whole sector skips
+   the disk read. CLASS is CACHE_DATA or CACHE_METADATA.*/
 void
 bc_write (block_sector_t sector_idx, const void *buffer,
-          off_t bytes_written, int chunk_size, int sector_ofs)
+          off_t bytes_written, int chunk_size, int sector_ofs,
+          enum cache_class class)
 {
-  struct buffer_head *in_cache = bc_lookup (sector_idx);
-
-  if (in_cache != NULL) /* Cache hit! */
-    lock_acquire (&in_cache->buffer_lock);
-  else /* Cache miss! */
-  {
-    int idx;
-
-    for (idx = 0; idx < BUFFER_CACHE_ENTRY_NB; idx++)
-      if (!buffer_head[idx].in_use)
-        break;
+  bool full = sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE;
+  struct buffer_head *in_cache
+    = bc_get_entry (sector_idx, full ? BC_FILL_NONE : BC_FILL_READ,
+                    class);
 
-    if (idx < BUFFER_CACHE_ENTRY_NB) /* Buffer cache is not full! */
-      in_cache = &buffer_head[idx]; /* Select empty entry. */
-    else /* Buffer cache is full! */
-      in_cache = bc_select_victim (); /* Select victim. */
-
-    lock_acquire (&in_cache->buffer_lock);
-    block_read (fs_device, sector_idx, in_cache->data);
-  }
   memcpy (in_cache->data + sector_ofs, buffer + bytes_written, chunk_size);
-  in_cache->dirty = true;
-  in_cache->in_use = true;
-  in_cache->accessed = true;
-  in_cache->sector = sector_idx;
-  lock_release (&in_cache->buffer_lock);
+  bc_put_entry (in_cache, true);
 }
 /////////////////////////////////////////////////////////////////////////////
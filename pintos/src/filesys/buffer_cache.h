@@ -2,6 +2,9 @@
 #ifndef BUFFER_CACHE_H
 #define BUFFER_CACHE_H
 
+#include <cache-stats.h>
+#include <hash.h>
+#include <list.h>
 #include "threads/synch.h"
 #include "devices/block.h"
 #include "filesys/off_t.h"
@@ -11,21 +14,40 @@ struct buffer_head
   bool dirty;               /* Buffer is dirty or not. */
   bool in_use;              /* Buffer is in use or not. */
   bool accessed;            /* Buffer has been accessed or not. */
+  bool prefetched;          /* Read ahead and not yet used. */
   block_sector_t sector;    /* Sector number. */
+  enum cache_class class;   /* Kind of sector, as told by holder. */
+  int pin_cnt;              /* Number of threads using this buffer. */
   struct lock buffer_lock;  /* Lock for buffer access. */
   void *data;               /* Pointer to actual buffer cache */
+  struct hash_elem hash_elem; /* Element for sector index. */
+  struct list_elem free_elem; /* Element for free list. */
+  struct list_elem clock_elem; /* Element for clock list. */
+  struct bc_queue *queue;   /* Replacement policy queue, if any. */
+  struct list_elem queue_elem; /* Element for queue. */
 };
 
+void bc_configure (size_t entry_nb, size_t max_entry_nb);
+void bc_configure_flusher (int interval_ms, int dirty_ratio);
+bool bc_configure_policy (const char *name);
 void bc_init (void);
 void bc_term (void);
-struct buffer_head *bc_select_victim (void);
-struct buffer_head *bc_lookup (block_sector_t sector);
+bool bc_shrink (void);
 void bc_flush_entry (struct buffer_head *p_flush_entry);
 void bc_flush_all_entries (void);
+struct buffer_head *bc_get (block_sector_t sector, enum cache_class class);
+struct buffer_head *bc_get_new (block_sector_t sector,
+                                enum cache_class class);
+void bc_release (struct buffer_head *bh, bool dirty);
+void bc_read_ahead (block_sector_t sector);
+void bc_get_stats (struct cache_stats *stats);
+void bc_print_stats (void);
 void bc_read (block_sector_t sector_idx, void *buffer,
-              off_t bytes_read, int chunk_size, int sector_ofs);
+              off_t bytes_read, int chunk_size, int sector_ofs,
+              enum cache_class class);
 void bc_write (block_sector_t sector_idx, const void *buffer,
-               off_t bytes_written, int chunk_size, int sector_ofs);
+               off_t bytes_written, int chunk_size, int sector_ofs,
+               enum cache_class class);
 
 #endif /* filesys/buffer_cache.h */
 /////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,207 @@
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+#include "filesys/dentry_cache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+#define DENTRY_CACHE_ENTRY_NB 128       /* Names cached at most. */
+
+/* A cached name: NAME in directory DIR is the file whose inode is
+   in SECTOR, or, if SECTOR is 0, there is no such file. Sector 0
+   holds the free map, so no directory entry refers to it. */
+struct dc_entry
+{
+  block_sector_t dir;         /* Sector of directory's inode. */
+  char name[NAME_MAX + 1];    /* Null terminated file name. */
+  block_sector_t sector;      /* Sector of file's inode, or 0. */
+  struct hash_elem hash_elem; /* Element for dc_index. */
+  struct list_elem elem;      /* Element for dc_lru or dc_free. */
+};
+
+static struct dc_entry *dc_entries;   /* All entries. */
+static struct hash dc_index;          /* Entries in use, by dir and name. */
+static struct list dc_lru;            /* Entries in use, least recent
+                                         first. */
+static struct list dc_free;           /* Entries not in use. */
+static struct lock dc_lock;           /* Protects all of the above. */
+
+static unsigned long long dc_hits;     /* Lookups of existing files. */
+static unsigned long long dc_neg_hits; /* Lookups of missing files. */
+static unsigned long long dc_misses;   /* Lookups left to directory. */
+
+static unsigned dc_hash_func (const struct hash_elem *e, void *aux);
+static bool dc_less_func (const struct hash_elem *a,
+                          const struct hash_elem *b, void *aux);
+static struct dc_entry *dc_find (block_sector_t dir, const char *name);
+
+/* Initialize dentry cache. Caching is left off if there is no
+   memory for it. */
+void
+dc_init (void)
+{
+  size_t i;
+
+  hash_init (&dc_index, dc_hash_func, dc_less_func, NULL);
+  list_init (&dc_lru);
+  list_init (&dc_free);
+  lock_init (&dc_lock);
+  dc_entries = calloc (DENTRY_CACHE_ENTRY_NB, sizeof *dc_entries);
+  if (dc_entries != NULL)
+    for (i = 0; i < DENTRY_CACHE_ENTRY_NB; i++)
+      list_push_back (&dc_free, &dc_entries[i].elem);
+}
+
+/* Hash function for dc_index. */
+static unsigned
+dc_hash_func (const struct hash_elem *e, void *aux UNUSED)
+{
+  struct dc_entry *d = hash_entry (e, struct dc_entry, hash_elem);
+
+  return hash_string (d->name) ^ hash_int (d->dir);
+}
+
+/* Compare function for dc_index. */
+static bool
+dc_less_func (const struct hash_elem *a, const struct hash_elem *b,
+              void *aux UNUSED)
+{
+  struct dc_entry *x = hash_entry (a, struct dc_entry, hash_elem);
+  struct dc_entry *y = hash_entry (b, struct dc_entry, hash_elem);
+
+  if (x->dir != y->dir)
+    return x->dir < y->dir;
+  return strcmp (x->name, y->name) < 0;
+}
+
+/* Return entry for NAME in DIR, or NULL if there is none.
+   Caller must hold dc_lock. */
+static struct dc_entry *
+dc_find (block_sector_t dir, const char *name)
+{
+  struct dc_entry key;
+  struct hash_elem *e;
+
+  key.dir = dir;
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&dc_index, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct dc_entry, hash_elem) : NULL;
+}
+
+/* Look up NAME in directory DIR. On a hit, set *SECTORP to the
+   sector of the file's inode, or to 0 if the file is known not
+   to exist, and return true. Return false on a miss. */
+bool
+dc_lookup (block_sector_t dir, const char *name, block_sector_t *sectorp)
+{
+  struct dc_entry *d;
+
+  if (strlen (name) > NAME_MAX)
+    return false;
+  lock_acquire (&dc_lock);
+  d = dc_find (dir, name);
+  if (d != NULL)
+  {
+    list_remove (&d->elem);
+    list_push_back (&dc_lru, &d->elem);
+    *sectorp = d->sector;
+    if (d->sector != 0)
+      dc_hits++;
+    else
+      dc_neg_hits++;
+  }
+  else
+    dc_misses++;
+  lock_release (&dc_lock);
+  return d != NULL;
+}
+
+/* Remember that NAME in directory DIR is the file whose inode is
+   in SECTOR, or that there is no such file if SECTOR is 0. Any
+   entry for NAME is replaced, so directory changes call this to
+   keep the cache up to date. The least recently used entry is
+   dropped when the cache is full. */
+void
+dc_insert (block_sector_t dir, const char *name, block_sector_t sector)
+{
+  struct dc_entry *d;
+
+  if (strlen (name) > NAME_MAX)
+    return;
+  lock_acquire (&dc_lock);
+  d = dc_find (dir, name);
+  if (d != NULL)
+    list_remove (&d->elem);
+  else
+  {
+    if (!list_empty (&dc_free))
+      d = list_entry (list_pop_front (&dc_free), struct dc_entry, elem);
+    else if (!list_empty (&dc_lru))
+    {
+      d = list_entry (list_pop_front (&dc_lru), struct dc_entry, elem);
+      hash_delete (&dc_index, &d->hash_elem);
+    }
+    if (d != NULL)
+    {
+      d->dir = dir;
+      strlcpy (d->name, name, sizeof d->name);
+      hash_insert (&dc_index, &d->hash_elem);
+    }
+  }
+  if (d != NULL)
+  {
+    d->sector = sector;
+    list_push_back (&dc_lru, &d->elem);
+  }
+  lock_release (&dc_lock);
+}
+
+/* Drop every entry for directory DIR, whose sector is about to
+   hold a new directory. */
+void
+dc_invalidate_dir (block_sector_t dir)
+{
+  struct list_elem *e, *next;
+
+  lock_acquire (&dc_lock);
+  for (e = list_begin (&dc_lru); e != list_end (&dc_lru); e = next)
+  {
+    struct dc_entry *d = list_entry (e, struct dc_entry, elem);
+
+    next = list_next (e);
+    if (d->dir == dir)
+    {
+      hash_delete (&dc_index, &d->hash_elem);
+      list_remove (&d->elem);
+      list_push_back (&dc_free, &d->elem);
+    }
+  }
+  lock_release (&dc_lock);
+}
+
+/* Copy dentry cache statistics into STATS. */
+void
+dc_get_stats (struct cache_stats *stats)
+{
+  lock_acquire (&dc_lock);
+  stats->dc_hits = dc_hits;
+  stats->dc_neg_hits = dc_neg_hits;
+  stats->dc_misses = dc_misses;
+  lock_release (&dc_lock);
+}
+
+/* Print dentry cache statistics. */
+void
+dc_print_stats (void)
+{
+  struct cache_stats s;
+
+  dc_get_stats (&s);
+  printf ("Dentry cache: %llu hits, %llu negative hits, %llu misses\n",
+          s.dc_hits, s.dc_neg_hits, s.dc_misses);
+}
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,18 @@
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+#ifndef DENTRY_CACHE_H
+#define DENTRY_CACHE_H
+
+#include <cache-stats.h>
+#include <stdbool.h>
+#include "devices/block.h"
+
+void dc_init (void);
+bool dc_lookup (block_sector_t dir, const char *name,
+                block_sector_t *sectorp);
+void dc_insert (block_sector_t dir, const char *name, block_sector_t sector);
+void dc_invalidate_dir (block_sector_t dir);
+void dc_get_stats (struct cache_stats *stats);
+void dc_print_stats (void);
+
+#endif /* filesys/dentry_cache.h */
+/////////////////////////////////////////////////////////////////////////////
@@ -5,6 +5,12 @@
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+#include <hash.h>
+#include <round.h>
+#include "filesys/dentry_cache.h"
+#include "threads/synch.h"
+/////////////////////////////////////////////////////////////////////////////
 
 /* A directory. */
 struct dir 
@@ -21,12 +27,201 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+/* Entries of a directory are kept in a hash table on disk. Each
+   sector of a directory is a bucket of entries, and an entry goes
+   in the bucket its name hashes to or, if that one is full, in one
+   of the next few. So looking up, adding or removing a name reads
+   at most DIR_MAX_PROBE sectors, however large the directory is.
+   The number of buckets is a power of 2, given by the length of
+   the directory, and doubles when a new entry doesn't fit, up to
+   DIR_MAX_BUCKETS.
+
+   A free entry whose name is empty was never used. A lookup may
+   stop at a bucket with such an entry, since an add would have
+   put the name there before going on to the next bucket. A
+   removed entry keeps its name, so it doesn't stop lookups. */
+
+/* Entries in one bucket. */
+#define BUCKET_ENTRIES (BLOCK_SECTOR_SIZE / sizeof (struct dir_entry))
+
+/* Buckets looked at for one name. */
+#define DIR_MAX_PROBE 4
+
+/* A bucket of entries, filling one sector. */
+struct dir_bucket
+  {
+    struct dir_entry entries[BUCKET_ENTRIES];
+    uint8_t unused[BLOCK_SECTOR_SIZE
+                   - BUCKET_ENTRIES * sizeof (struct dir_entry)];
+  };
+
+/* Largest number of buckets a directory grows to. Growing
+   rewrites every bucket, and this keeps the rewrite small enough
+   to commit as part of a single journal transaction. */
+#define DIR_MAX_BUCKETS 64
+
+/* Return the lock that serializes changes to DIR, and lookups
+   against it, since it may be rehashed as a whole. */
+static struct lock *
+dir_lock (const struct dir *dir)
+{
+  return inode_dir_lock (dir->inode);
+}
+
+/* Return number of buckets of DIR. */
+static size_t
+bucket_cnt (const struct dir *dir)
+{
+  return inode_length (dir->inode) / BLOCK_SECTOR_SIZE;
+}
+
+/* Return index of bucket that NAME hashes to in a table of CNT
+   buckets, where CNT is a power of 2. */
+static size_t
+home_bucket (const char *name, size_t cnt)
+{
+  return hash_string (name) & (cnt - 1);
+}
+
+/* Find the I'th bucket to look at for NAME in DIR, and read it
+   into BUCKET. Return the bucket's index, or SIZE_MAX if there
+   is no I'th bucket or it can't be read. */
+static size_t
+read_bucket (const struct dir *dir, const char *name, size_t i,
+             struct dir_bucket *bucket)
+{
+  size_t cnt = bucket_cnt (dir);
+  size_t idx;
+
+  if (i >= DIR_MAX_PROBE || i >= cnt)
+    return SIZE_MAX;
+  idx = (home_bucket (name, cnt) + i) & (cnt - 1);
+  if (inode_read_at (dir->inode, bucket, sizeof *bucket,
+                     idx * BLOCK_SECTOR_SIZE) != sizeof *bucket)
+    return SIZE_MAX;
+  return idx;
+}
+
+/* Put entry E into the table of CNT buckets in memory at TABLE.
+   Return false if the buckets it may go in are all full. */
+static bool
+insert_entry (struct dir_bucket *table, size_t cnt,
+              const struct dir_entry *e)
+{
+  size_t home = home_bucket (e->name, cnt);
+  size_t i, j;
+
+  for (i = 0; i < DIR_MAX_PROBE && i < cnt; i++)
+  {
+    struct dir_bucket *bucket = &table[(home + i) & (cnt - 1)];
+
+    for (j = 0; j < BUCKET_ENTRIES; j++)
+      if (!bucket->entries[j].in_use)
+      {
+        bucket->entries[j] = *e;
+        return true;
+      }
+  }
+  return false;
+}
+
+/* Double the number of buckets of DIR, or more if needed, and
+   move its entries to their new buckets. Removed entries are
+   dropped along the way. Return false on a disk or memory
+   error, or if DIR would outgrow DIR_MAX_BUCKETS. */
+static bool
+grow (struct dir *dir)
+{
+  size_t old_cnt = bucket_cnt (dir);
+  size_t new_cnt = old_cnt * 2;
+  size_t size = old_cnt * sizeof (struct dir_bucket);
+  struct dir_bucket *old_table, *new_table = NULL;
+  bool success = false;
+  size_t i, j;
+
+  old_table = malloc (size);
+  if (old_table == NULL
+      || inode_read_at (dir->inode, old_table, size, 0) != (off_t) size)
+    goto done;
+
+  for (;;)
+  {
+    if (new_cnt > DIR_MAX_BUCKETS)
+      goto done;
+    new_table = calloc (new_cnt, sizeof *new_table);
+    if (new_table == NULL)
+      goto done;
+    for (i = 0; i < old_cnt; i++)
+      for (j = 0; j < BUCKET_ENTRIES; j++)
+        if (old_table[i].entries[j].in_use
+            && !insert_entry (new_table, new_cnt, &old_table[i].entries[j]))
+          goto retry;
+    break;
+
+  retry:
+    free (new_table);
+    new_cnt *= 2;
+  }
+
+  /* Allocate the whole new table before overwriting any bucket,
+     so running out of space leaves the old table intact. The
+     rewrite is part of the caller's journal transaction, so a
+     crash leaves either table on disk, never a mix. */
+  size = new_cnt * sizeof *new_table;
+  if (!inode_reserve (dir->inode, size, 0))
+    goto done;
+  success = inode_write_at (dir->inode, new_table, size, 0) == (off_t) size;
+
+ done:
+  free (new_table);
+  free (old_table);
+  return success;
+}
+
+/* Find a free entry for NAME in DIR and set *OFSP to its byte
+   offset. Return false if the buckets NAME may go in are all
+   full. */
+static bool
+find_slot (const struct dir *dir, const char *name, off_t *ofsp)
+{
+  struct dir_bucket *bucket = malloc (sizeof *bucket);
+  size_t i, j, idx;
+  bool found = false;
+
+  if (bucket == NULL)
+    return false;
+  for (i = 0; !found
+              && (idx = read_bucket (dir, name, i, bucket)) != SIZE_MAX; i++)
+    for (j = 0; j < BUCKET_ENTRIES; j++)
+      if (!bucket->entries[j].in_use)
+      {
+        *ofsp = idx * BLOCK_SECTOR_SIZE + j * sizeof (struct dir_entry);
+        found = true;
+        break;
+      }
+  free (bucket);
+  return found;
+}
+/////////////////////////////////////////////////////////////////////////////
+
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 bool
 dir_create (block_sector_t sector, size_t entry_cnt)
 {
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  /* old code */
+  // return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+  size_t buckets = 1;
+
+  while (buckets * BUCKET_ENTRIES < entry_cnt)
+    buckets *= 2;
+  dc_invalidate_dir (sector);
+  /* Entries are metadata; the journal keeps them consistent with
+     the inodes they name. */
+  return inode_create_metadata (sector, buckets * BLOCK_SECTOR_SIZE);
+/////////////////////////////////////////////////////////////////////////////
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -92,25 +287,83 @@ static bool
 lookup (const struct dir *dir, const char *name,
         struct dir_entry *ep, off_t *ofsp) 
 {
-  struct dir_entry e;
-  size_t ofs;
-  
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  /* old codes */
+  // struct dir_entry e;
+  // size_t ofs;
+  // 
+  // ASSERT (dir != NULL);
+  // ASSERT (name != NULL);
+  //
+  // for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  //      ofs += sizeof e) 
+  //   if (e.in_use && !strcmp (name, e.name)) 
+  //     {
+  //       if (ep != NULL)
+  //         *ep = e;
+  //       if (ofsp != NULL)
+  //         *ofsp = ofs;
+  //       return true;
+  //     }
+  // return false;
+  struct dir_bucket *bucket;
+  size_t i, j, idx;
+  bool found = false, open = false;
+
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
+  ASSERT (lock_held_by_current_thread (dir_lock (dir)));
 
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (e.in_use && !strcmp (name, e.name)) 
+  bucket = malloc (sizeof *bucket);
+  if (bucket == NULL)
+    return false;
+  for (i = 0; !found && !open
+              && (idx = read_bucket (dir, name, i, bucket)) != SIZE_MAX; i++)
+    for (j = 0; j < BUCKET_ENTRIES; j++)
+    {
+      struct dir_entry *e = &bucket->entries[j];
+
+      if (e->in_use && !strcmp (name, e->name))
       {
         if (ep != NULL)
-          *ep = e;
+          *ep = *e;
         if (ofsp != NULL)
-          *ofsp = ofs;
-        return true;
+          *ofsp = idx * BLOCK_SECTOR_SIZE + j * sizeof *e;
+        found = true;
+        break;
       }
-  return false;
+      if (e->name[0] == '\0')
+        open = true;
+    }
+  free (bucket);
+  return found;
+/////////////////////////////////////////////////////////////////////////////
 }
 
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+/* Searches DIR for a file with the given NAME, asking the dentry
+   cache first and telling it what was found otherwise. If
+   successful, returns true and sets *SECTORP to the sector of the
+   file's inode. Caller must hold DIR's lock. */
+static bool
+cached_lookup (const struct dir *dir, const char *name,
+               block_sector_t *sectorp)
+{
+  block_sector_t dir_sector = inode_get_inumber (dir->inode);
+  struct dir_entry e;
+
+  ASSERT (lock_held_by_current_thread (dir_lock (dir)));
+
+  if (dc_lookup (dir_sector, name, sectorp))
+    return *sectorp != 0;
+  if (!lookup (dir, name, &e, NULL))
+    e.inode_sector = 0;
+  dc_insert (dir_sector, name, e.inode_sector);
+  *sectorp = e.inode_sector;
+  return e.inode_sector != 0;
+}
+/////////////////////////////////////////////////////////////////////////////
+
 /* Searches DIR for a file with the given NAME
    and returns true if one exists, false otherwise.
    On success, sets *INODE to an inode for the file, otherwise to
@@ -119,15 +372,28 @@ bool
 dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode) 
 {
-  struct dir_entry e;
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  /* old code */
+  // struct dir_entry e;
+  block_sector_t sector;
+/////////////////////////////////////////////////////////////////////////////
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  lock_acquire (dir_lock (dir));
+  /* old codes */
+  // if (lookup (dir, name, &e, NULL))
+    // *inode = inode_open (e.inode_sector);
+  if (cached_lookup (dir, name, &sector))
+    *inode = inode_open (sector);
+/////////////////////////////////////////////////////////////////////////////
   else
     *inode = NULL;
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  lock_release (dir_lock (dir));
+/////////////////////////////////////////////////////////////////////////////
 
   return *inode != NULL;
 }
@@ -152,29 +418,52 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  lock_acquire (dir_lock (dir));
+/////////////////////////////////////////////////////////////////////////////
   /* Check that NAME is not in use. */
-  if (lookup (dir, name, NULL, NULL))
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  /* old code */
+  // if (lookup (dir, name, NULL, NULL))
+  if (cached_lookup (dir, name, &e.inode_sector))
+/////////////////////////////////////////////////////////////////////////////
     goto done;
 
-  /* Set OFS to offset of free slot.
-     If there are no free slots, then it will be set to the
-     current end-of-file.
-     
-     inode_read_at() will only return a short read at end of file.
-     Otherwise, we'd need to verify that we didn't get a short
-     read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (!e.in_use)
-      break;
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  /* old codes */
+  // /* Set OFS to offset of free slot.
+     // If there are no free slots, then it will be set to the
+     // current end-of-file.
+     // 
+     // inode_read_at() will only return a short read at end of file.
+     // Otherwise, we'd need to verify that we didn't get a short
+     // read due to something intermittent such as low memory. */
+  // for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+       // ofs += sizeof e) 
+    // if (!e.in_use)
+      // break;
+
+  /* Set OFS to offset of a free entry in one of NAME's buckets,
+     growing the table until there is one. */
+  while (!find_slot (dir, name, &ofs))
+    if (!grow (dir))
+      goto done;
+/////////////////////////////////////////////////////////////////////////////
 
   /* Write slot. */
   e.in_use = true;
   strlcpy (e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  if (success)
+    dc_insert (inode_get_inumber (dir->inode), name, inode_sector);
+/////////////////////////////////////////////////////////////////////////////
 
  done:
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  lock_release (dir_lock (dir));
+/////////////////////////////////////////////////////////////////////////////
   return success;
 }
 
@@ -192,6 +481,9 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  lock_acquire (dir_lock (dir));
+/////////////////////////////////////////////////////////////////////////////
   /* Find directory entry. */
   if (!lookup (dir, name, &e, &ofs))
     goto done;
@@ -202,15 +494,24 @@ dir_remove (struct dir *dir, const char *name)
     goto done;
 
   /* Erase directory entry. */
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  /* E keeps its name, so lookups go on past it. */
+/////////////////////////////////////////////////////////////////////////////
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  dc_insert (inode_get_inumber (dir->inode), name, 0);
+/////////////////////////////////////////////////////////////////////////////
 
   /* Remove inode. */
   inode_remove (inode);
   success = true;
 
  done:
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  lock_release (dir_lock (dir));
+/////////////////////////////////////////////////////////////////////////////
   inode_close (inode);
   return success;
 }
@@ -221,16 +522,79 @@ dir_remove (struct dir *dir, const char *name)
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
-  struct dir_entry e;
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  /* old codes */
+  // struct dir_entry e;
+  //
+  // while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
+    // {
+      // dir->pos += sizeof e;
+      // if (e.in_use)
+        // {
+          // strlcpy (name, e.name, NAME_MAX + 1);
+          // return true;
+        // } 
+    // }
+  // return false;
+  return dir_readdir_many (dir, (char (*)[NAME_MAX + 1]) name, 1) == 1;
+/////////////////////////////////////////////////////////////////////////////
+}
 
-  while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
-    {
-      dir->pos += sizeof e;
-      if (e.in_use)
-        {
-          strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
-        } 
-    }
-  return false;
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+/* Reads up to CNT of the next directory entries in DIR and
+   stores their names in NAMES. A whole bucket is read at once
+   and its entries are walked in memory, so listing a directory
+   costs one read per sector. Returns the number of names read,
+   which is less than CNT only at the end of the directory. */
+size_t
+dir_readdir_many (struct dir *dir, char (*names)[NAME_MAX + 1], size_t cnt)
+{
+  struct dir_bucket *bucket = malloc (sizeof *bucket);
+  size_t n = 0;
+
+  if (bucket == NULL)
+    return 0;
+  while (n < cnt)
+  {
+    off_t start = ROUND_DOWN (dir->pos, BLOCK_SECTOR_SIZE);
+    size_t j = (dir->pos - start) / sizeof (struct dir_entry);
+    off_t bytes;
+
+    /* Hold the lock only while reading, so a rehash doesn't
+       change the bucket part way through. */
+    lock_acquire (dir_lock (dir));
+    bytes = inode_read_at (dir->inode, bucket, sizeof *bucket, start);
+    lock_release (dir_lock (dir));
+    if (bytes != sizeof *bucket)
+      break;
+    for (; j < BUCKET_ENTRIES && n < cnt; j++)
+      if (bucket->entries[j].in_use)
+        strlcpy (names[n++], bucket->entries[j].name, NAME_MAX + 1);
+    if (j < BUCKET_ENTRIES)
+      dir->pos = start + j * sizeof (struct dir_entry);
+    else
+      dir->pos = start + BLOCK_SECTOR_SIZE;
+  }
+  free (bucket);
+  return n;
+}
+
+/* Sets the position in DIR that the next dir_readdir() starts
+   from to POS, as returned by dir_tell(). */
+void
+dir_seek (struct dir *dir, off_t pos)
+{
+  ASSERT (pos >= 0);
+  dir->pos = pos;
+}
+
+/* Returns the position in DIR that the next dir_readdir() starts
+   from. Entries added or removed after that may or may not be
+   returned, and a directory that grows in between is read from
+   its new layout. */
+off_t
+dir_tell (struct dir *dir)
+{
+  return dir->pos;
 }
+/////////////////////////////////////////////////////////////////////////////
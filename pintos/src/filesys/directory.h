@@ -4,6 +4,9 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include "devices/block.h"
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+#include "filesys/off_t.h"
+/////////////////////////////////////////////////////////////////////////////
 
 /* Maximum length of a file name component.
    This is the traditional UNIX maximum length.
@@ -26,5 +29,11 @@ bool dir_lookup (const struct dir *, const char *name, struct inode **);
 bool dir_add (struct dir *, const char *name, block_sector_t);
 bool dir_remove (struct dir *, const char *name);
 bool dir_readdir (struct dir *, char name[NAME_MAX + 1]);
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+size_t dir_readdir_many (struct dir *, char (*names)[NAME_MAX + 1],
+                         size_t cnt);
+void dir_seek (struct dir *, off_t);
+off_t dir_tell (struct dir *);
+/////////////////////////////////////////////////////////////////////////////
 
 #endif /* filesys/directory.h */
@@ -113,6 +113,34 @@ file_write_at (struct file *file, const void *buffer, off_t size,
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+/* Reads from FILE into the IOVCNT buffers of IOV in turn,
+   starting at the file's current position.
+   Returns the number of bytes actually read,
+   which may be less than requested if end of file is reached.
+   Advances FILE's position by the number of bytes read. */
+off_t
+file_readv (struct file *file, const struct iovec *iov, int iovcnt)
+{
+  off_t bytes_read = inode_readv (file->inode, iov, iovcnt, file->pos);
+  file->pos += bytes_read;
+  return bytes_read;
+}
+
+/* Writes the IOVCNT buffers of IOV in turn into FILE,
+   starting at the file's current position.
+   Returns the number of bytes actually written,
+   which may be less than requested if the disk is full.
+   Advances FILE's position by the number of bytes written. */
+off_t
+file_writev (struct file *file, const struct iovec *iov, int iovcnt)
+{
+  off_t bytes_written = inode_writev (file->inode, iov, iovcnt, file->pos);
+  file->pos += bytes_written;
+  return bytes_written;
+}
+/////////////////////////////////////////////////////////////////////////////
+
 /* Prevents write operations on FILE's underlying inode
    until file_allow_write() is called or FILE is closed. */
 void
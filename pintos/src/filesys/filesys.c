@@ -8,6 +8,8 @@
 #include "filesys/directory.h"
 //////////////////////////////// PJ4 EDITED /////////////////////////////////
 #include "filesys/buffer_cache.h"
+#include "filesys/dentry_cache.h"
+#include "filesys/journal.h"
 /////////////////////////////////////////////////////////////////////////////
 
 /* Partition that contains the file system. */
@@ -24,10 +26,16 @@ filesys_init (bool format)
   if (fs_device == NULL)
     PANIC ("No file system device found, can't initialize file system.");
 
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  journal_init ();
+/////////////////////////////////////////////////////////////////////////////
   inode_init ();
   free_map_init ();
 //////////////////////////////// PJ4 EDITED /////////////////////////////////
   bc_init ();
+  dc_init ();
+  /* Replay metadata a crash left in the journal before any is read. */
+  journal_open (format);
 /////////////////////////////////////////////////////////////////////////////
 
   if (format)
@@ -42,9 +50,16 @@ void
 filesys_done (void)
 {
 //////////////////////////////// PJ4 EDITED /////////////////////////////////
-  bc_term ();
+  inode_done ();
+  /* old codes */
+  // free_map_flush ();
+  // bc_term ();
 /////////////////////////////////////////////////////////////////////////////
   free_map_close ();
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  journal_done ();
+  bc_term ();
+/////////////////////////////////////////////////////////////////////////////
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
@@ -55,14 +70,34 @@ bool
 filesys_create (const char *name, off_t initial_size)
 {
   block_sector_t inode_sector = 0;
-  struct dir *dir = dir_open_root ();
-  bool success = (dir != NULL
-                  && free_map_allocate (1, &inode_sector)
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  /* old code */
+  // struct dir *dir = dir_open_root ();
+  struct dir *dir;
+  bool success;
+
+  /* The new inode, its directory entry and its free map bit commit
+     together. */
+  journal_begin ();
+  dir = dir_open_root ();
+  success = (dir != NULL
+/////////////////////////////////////////////////////////////////////////////
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+                  /* old code */
+                  // && free_map_allocate (1, &inode_sector)
+                  /* Put the inode in its directory's block group. */
+                  && free_map_allocate_near (1, inode_get_inumber (
+                                               dir_get_inode (dir)),
+                                             &inode_sector)
+/////////////////////////////////////////////////////////////////////////////
                   && inode_create (inode_sector, initial_size)
                   && dir_add (dir, name, inode_sector));
   if (!success && inode_sector != 0)
     free_map_release (inode_sector, 1);
   dir_close (dir);
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  journal_end ();
+/////////////////////////////////////////////////////////////////////////////
 
   return success;
 }
@@ -92,9 +127,20 @@ filesys_open (const char *name)
 bool
 filesys_remove (const char *name)
 {
-  struct dir *dir = dir_open_root ();
-  bool success = dir != NULL && dir_remove (dir, name);
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  /* old codes */
+  // struct dir *dir = dir_open_root ();
+  // bool success = dir != NULL && dir_remove (dir, name);
+  // dir_close (dir);
+  struct dir *dir;
+  bool success;
+
+  journal_begin ();
+  dir = dir_open_root ();
+  success = dir != NULL && dir_remove (dir, name);
   dir_close (dir);
+  journal_end ();
+/////////////////////////////////////////////////////////////////////////////
 
   return success;
 }
@@ -104,9 +150,16 @@ static void
 do_format (void)
 {
   printf ("Formatting file system...");
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  journal_begin ();
+/////////////////////////////////////////////////////////////////////////////
   free_map_create ();
   if (!dir_create (ROOT_DIR_SECTOR, 16))
     PANIC ("root directory creation failed");
   free_map_close ();
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  journal_end ();
+  journal_commit ();
+/////////////////////////////////////////////////////////////////////////////
   printf ("done.\n");
 }
@@ -4,9 +4,143 @@
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+#include <round.h>
+#include "filesys/journal.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Bits of free map stored in one sector of its file. */
+#define BITS_PER_SECTOR (BLOCK_SECTOR_SIZE * 8)
+
+/* Sectors per block group. Related sectors are kept within one
+   group when possible, so reading them seeks less. */
+#define GROUP_SECTORS 1024
+
+/* A block group: GROUP_SECTORS consecutive sectors of the disk. */
+struct free_map_group
+  {
+    size_t free_cnt;                 /* Free sectors in group. */
+    size_t hint;                     /* Where next search starts. */
+  };
+/////////////////////////////////////////////////////////////////////////////
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+static struct lock free_map_lock;    /* Serializes allocation, now that
+                                        different files grow concurrently. */
+static struct bitmap *free_map_dirty; /* Sectors of free map file that
+                                        differ from free_map. */
+static size_t free_map_hint;         /* Where next search starts, when
+                                        caller gives no goal. */
+static struct free_map_group *groups; /* Block groups. */
+static size_t group_cnt;             /* Number of block groups. */
+
+/* Record that bits SECTOR to SECTOR + CNT - 1 of free map
+   changed, so free_map_flush() writes the sectors of free map
+   file that hold them. Caller must hold free_map_lock. */
+static void
+mark_dirty (block_sector_t sector, size_t cnt)
+{
+  size_t first = sector / BITS_PER_SECTOR;
+  size_t last = (sector + cnt - 1) / BITS_PER_SECTOR;
+
+  if (cnt > 0)
+    bitmap_set_multiple (free_map_dirty, first, last - first + 1, true);
+}
+
+/* Recount free sectors of every block group from free map. */
+static void
+count_groups (void)
+{
+  size_t i;
+
+  for (i = 0; i < group_cnt; i++)
+    {
+      size_t start = i * GROUP_SECTORS;
+      size_t cnt = bitmap_size (free_map) - start;
+
+      if (cnt > GROUP_SECTORS)
+        cnt = GROUP_SECTORS;
+      groups[i].free_cnt = bitmap_count (free_map, start, cnt, false);
+      groups[i].hint = start;
+    }
+}
+
+/* Mark CNT sectors starting at SECTOR as used if USED is true,
+   free otherwise, and update free counts of the groups they lie
+   in. Caller must hold free_map_lock. */
+static void
+set_sectors (block_sector_t sector, size_t cnt, bool used)
+{
+  size_t end = sector + cnt;
+
+  bitmap_set_multiple (free_map, sector, cnt, used);
+  mark_dirty (sector, cnt);
+  while (sector < end)
+    {
+      struct free_map_group *g = &groups[sector / GROUP_SECTORS];
+      size_t group_end = (sector / GROUP_SECTORS + 1) * GROUP_SECTORS;
+      size_t n = (end < group_end ? end : group_end) - sector;
+
+      if (used)
+        g->free_cnt -= n;
+      else
+        g->free_cnt += n;
+      sector += n;
+    }
+}
+
+/* Find CNT consecutive free sectors, starting the search at GOAL
+   and moving on group by group. Within GOAL's group, the search
+   goes forward from GOAL, then back to the start of the group;
+   in other groups, it starts at the group's hint. Groups with no
+   free sector are skipped without looking at free map. A run
+   may straddle the end of the group it starts in.
+   Returns the first sector, or BITMAP_ERROR if there is none.
+   Caller must hold free_map_lock. */
+static size_t
+find_near (size_t cnt, block_sector_t goal)
+{
+  size_t size = bitmap_size (free_map);
+  size_t first = goal < size ? goal / GROUP_SECTORS : 0;
+  size_t i;
+
+  for (i = 0; i < group_cnt; i++)
+    {
+      size_t g = (first + i) % group_cnt;
+      size_t gstart = g * GROUP_SECTORS;
+      size_t gend = gstart + GROUP_SECTORS;
+      size_t start = i == 0 && goal < size ? goal : groups[g].hint;
+      size_t idx;
+
+      if (groups[g].free_cnt == 0)
+        continue;
+      if (gend > size)
+        gend = size;
+      if (start < gstart || start >= gend)
+        start = gstart;
+
+      /* Groups starting in [START, GEND). */
+      idx = bitmap_scan_range (free_map, start,
+                               gend + cnt - 1 < size ? gend + cnt - 1 : size,
+                               cnt, false);
+      /* Groups starting in [GSTART, START). */
+      if (idx == BITMAP_ERROR && start > gstart)
+        idx = bitmap_scan_range (free_map, gstart,
+                                 start + cnt - 1 < size
+                                 ? start + cnt - 1 : size,
+                                 cnt, false);
+      if (idx != BITMAP_ERROR)
+        {
+          groups[g].hint = idx + cnt;
+          return idx;
+        }
+    }
+  return BITMAP_ERROR;
+}
+/////////////////////////////////////////////////////////////////////////////
 
 /* Initializes the free map. */
 void
@@ -17,37 +151,168 @@ free_map_init (void)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  bitmap_set_multiple (free_map, JOURNAL_SECTOR, JOURNAL_SECTORS, true);
+  lock_init (&free_map_lock);
+  free_map_dirty = bitmap_create (DIV_ROUND_UP (bitmap_size (free_map),
+                                                BITS_PER_SECTOR));
+  if (free_map_dirty == NULL)
+    PANIC ("bitmap creation failed--file system device is too large");
+  group_cnt = DIV_ROUND_UP (bitmap_size (free_map), GROUP_SECTORS);
+  groups = malloc (group_cnt * sizeof *groups);
+  if (groups == NULL)
+    PANIC ("block group creation failed--file system device is too large");
+  count_groups ();
+/////////////////////////////////////////////////////////////////////////////
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
    the first into *SECTORP.
    Returns true if successful, false if not enough consecutive
-   sectors were available or if the free_map file could not be
-   written. */
+   sectors were available. The change reaches the free map file
+   on the next free_map_flush(). */
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  /* old codes */
+  // block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
+  // if (sector != BITMAP_ERROR
+      // && free_map_file != NULL
+      // && !bitmap_write (free_map, free_map_file))
+    // {
+      // bitmap_set_multiple (free_map, sector, cnt, false); 
+      // sector = BITMAP_ERROR;
+    // }
+  // if (sector != BITMAP_ERROR)
+    // *sectorp = sector;
+  // return sector != BITMAP_ERROR;
+
+  /* Next fit: continue where the last allocation ended, instead
+     of rescanning the full start of the disk every time. */
+  return free_map_allocate_near (cnt, free_map_hint, sectorp);
+/////////////////////////////////////////////////////////////////////////////
+}
+
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+/* Like free_map_allocate(), but looks for the sectors at GOAL
+   first, then elsewhere in GOAL's block group, then in the
+   following groups. */
+bool
+free_map_allocate_near (size_t cnt, block_sector_t goal,
+                        block_sector_t *sectorp)
+{
+  size_t sector;
+
+  lock_acquire (&free_map_lock);
+  sector = find_near (cnt, goal);
+  if (sector != BITMAP_ERROR)
     {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      set_sectors (sector, cnt, true);
+      free_map_hint = sector + cnt;
+      *sectorp = sector;
     }
-  if (sector != BITMAP_ERROR)
-    *sectorp = sector;
+  lock_release (&free_map_lock);
   return sector != BITMAP_ERROR;
 }
 
+/* Allocates a run of up to CNT consecutive sectors and stores
+   the first into *SECTORP. A run of all CNT sectors is preferred;
+   if there is none, the next free run is taken, however short.
+   Both searches continue where the last allocation ended.
+   Returns the number of sectors allocated, or 0 if the disk is
+   full. */
+size_t
+free_map_allocate_run (size_t cnt, block_sector_t *sectorp)
+{
+  return free_map_allocate_run_near (cnt, free_map_hint, sectorp);
+}
+
+/* Like free_map_allocate_run(), but both searches start at GOAL
+   as in free_map_allocate_near(). */
+size_t
+free_map_allocate_run_near (size_t cnt, block_sector_t goal,
+                            block_sector_t *sectorp)
+{
+  size_t sector, run;
+
+  ASSERT (cnt > 0);
+  lock_acquire (&free_map_lock);
+  sector = find_near (cnt, goal);
+  if (sector != BITMAP_ERROR)
+    run = cnt;
+  else
+    {
+      sector = find_near (1, goal);
+      if (sector == BITMAP_ERROR)
+        {
+          lock_release (&free_map_lock);
+          return 0;
+        }
+      for (run = 1; run < cnt && sector + run < bitmap_size (free_map)
+                    && !bitmap_test (free_map, sector + run); run++)
+        continue;
+    }
+
+  set_sectors (sector, run, true);
+  free_map_hint = sector + run;
+  lock_release (&free_map_lock);
+  *sectorp = sector;
+  return run;
+}
+/////////////////////////////////////////////////////////////////////////////
+
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  lock_acquire (&free_map_lock);
+/////////////////////////////////////////////////////////////////////////////
   ASSERT (bitmap_all (free_map, sector, cnt));
-  bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  /* old codes */
+  // bitmap_set_multiple (free_map, sector, cnt, false);
+  // bitmap_write (free_map, free_map_file);
+  set_sectors (sector, cnt, false);
+  lock_release (&free_map_lock);
+  /* They may be reused as file data, which the journal must not
+     overwrite with metadata it still holds for them. */
+  journal_revoke (sector, cnt);
+/////////////////////////////////////////////////////////////////////////////
+}
+
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+/* Writes the sectors of the free map file whose bits changed
+   since the last flush, instead of the whole bitmap. Called on
+   every journal commit, so allocations and releases in between
+   share one write per sector. */
+void
+free_map_flush (void)
+{
+  size_t idx;
+
+  /* Begin before free_map_lock, since beginning may commit, and
+     commit flushes free map. */
+  journal_begin ();
+  lock_acquire (&free_map_lock);
+  if (free_map_file != NULL)
+    for (idx = bitmap_scan (free_map_dirty, 0, 1, true);
+         idx != BITMAP_ERROR;
+         idx = bitmap_scan (free_map_dirty, idx + 1, 1, true))
+      {
+        size_t start = idx * BITS_PER_SECTOR;
+        size_t cnt = bitmap_size (free_map) - start;
+
+        if (cnt > BITS_PER_SECTOR)
+          cnt = BITS_PER_SECTOR;
+        bitmap_write_part (free_map, free_map_file, start, cnt);
+        bitmap_reset (free_map_dirty, idx);
+      }
+  lock_release (&free_map_lock);
+  journal_end ();
 }
+/////////////////////////////////////////////////////////////////////////////
 
 /* Opens the free map file and reads it from disk. */
 void
@@ -58,13 +323,23 @@ free_map_open (void)
     PANIC ("can't open free map");
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  count_groups ();
+/////////////////////////////////////////////////////////////////////////////
 }
 
 /* Writes the free map to disk and closes the free map file. */
 void
 free_map_close (void) 
 {
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  free_map_flush ();
+/////////////////////////////////////////////////////////////////////////////
   file_close (free_map_file);
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  /* Later journal commits must not flush into the closed file. */
+  free_map_file = NULL;
+/////////////////////////////////////////////////////////////////////////////
 }
 
 /* Creates a new free map file on disk and writes the free map to
@@ -72,14 +347,29 @@ free_map_close (void)
 void
 free_map_create (void) 
 {
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  struct file *file;
+/////////////////////////////////////////////////////////////////////////////
+
   /* Create inode. */
-  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  /* old code */
+  // if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
+  if (!inode_create_metadata (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
+/////////////////////////////////////////////////////////////////////////////
     PANIC ("free map creation failed");
 
   /* Write bitmap to file. */
-  free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
-  if (free_map_file == NULL)
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  /* The file is created sparse and gets its sectors on this first
+     write. free_map_file stays null until then, so allocating them
+     doesn't write the free map recursively. */
+  file = file_open (inode_open (FREE_MAP_SECTOR));
+  if (file == NULL)
     PANIC ("can't open free map");
-  if (!bitmap_write (free_map, free_map_file))
+  if (!bitmap_write (free_map, file))
     PANIC ("can't write free map");
+  bitmap_set_all (free_map_dirty, false);
+  free_map_file = file;
+/////////////////////////////////////////////////////////////////////////////
 }
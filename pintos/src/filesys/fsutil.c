@@ -7,6 +7,9 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+#include "filesys/inode.h"
+/////////////////////////////////////////////////////////////////////////////
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
@@ -123,6 +126,13 @@ fsutil_extract (char **argv UNUSED)
           dst = filesys_open (file_name);
           if (dst == NULL)
             PANIC ("%s: open failed", file_name);
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+          /* Allocate the file in long runs before copying. It
+             already has its full size, so its sectors are zeroed
+             in cache, which costs no disk read. */
+          inode_reserve (file_get_inode (dst), size,
+                         INODE_RESERVE_NO_ZERO | INODE_RESERVE_KEEP_SIZE);
+/////////////////////////////////////////////////////////////////////////////
 
           /* Do copy. */
           while (size > 0)
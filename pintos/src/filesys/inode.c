@@ -1,6 +1,10 @@
 #include "filesys/inode.h"
 #include <list.h>
 #include <debug.h>
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+#include <hash.h>
+#include <iovec.h>
+/////////////////////////////////////////////////////////////////////////////
 #include <round.h>
 #include <string.h>
 #include "filesys/filesys.h"
@@ -8,6 +12,8 @@
 #include "threads/malloc.h"
 //////////////////////////////// PJ4 EDITED /////////////////////////////////
 #include "filesys/buffer_cache.h"
+#include "filesys/journal.h"
+#include "threads/thread.h"
 /////////////////////////////////////////////////////////////////////////////
 
 /* Identifies an inode. */
@@ -15,7 +21,11 @@
 
 //////////////////////////////// PJ4 EDITED /////////////////////////////////
 #define INDIRECT_BLOCK_ENTRIES 128  /* A block can contain 128 sector numbers */
-#define DIRECT_BLOCK_ENTRIES 124    /* Make inode_disk fit in BLOCK_SECTOR_SIZE */
+#define DIRECT_BLOCK_ENTRIES 123    /* Make inode_disk fit in BLOCK_SECTOR_SIZE */
+#define INLINE_DATA_SIZE 500        /* Largest file kept in inode sector */
+#define READ_AHEAD_SECTORS 8        /* Sectors read ahead of sequential read */
+#define OPEN_INODE_STRIPES 16       /* Independently locked open tables */
+#define RESERVE_STEP (1024 * 1024)  /* Bytes reserved per transaction */
 
 enum direct_t
   {
@@ -37,6 +47,15 @@ struct inode_indirect_block
     /* Index block structure. */
     block_sector_t map_table[INDIRECT_BLOCK_ENTRIES];
   };
+
+/* Flags of on-disk inode. */
+enum inode_disk_flags
+  {
+    INODE_INLINE = 001,             /* Data is in inline_data, not in
+                                       sectors mapped by index. */
+    INODE_METADATA = 002            /* Data is file system metadata,
+                                       written home by the journal. */
+  };
 /////////////////////////////////////////////////////////////////////////////
 
 /* On-disk inode.
@@ -48,9 +67,19 @@ struct inode_disk
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
     // uint32_t unused[125];            /* Not used. */
-    block_sector_t direct_map_table[DIRECT_BLOCK_ENTRIES]; /* Direct blocks. */
-    block_sector_t indirect_block_sec;                   /* Indirect blocks. */
-    block_sector_t double_indirect_block_sec;     /* Double indirect blocks. */
+    uint32_t flags;                     /* Combination of INODE_*. */
+    union
+      {
+        /* Index of a file mapped to data sectors. */
+        struct
+          {
+            block_sector_t direct_map_table[DIRECT_BLOCK_ENTRIES];
+            block_sector_t indirect_block_sec;
+            block_sector_t double_indirect_block_sec;
+          };
+        /* Contents of an INODE_INLINE file, zero past its length. */
+        uint8_t inline_data[INLINE_DATA_SIZE];
+      };
 /////////////////////////////////////////////////////////////////////////////
   };
 
@@ -65,25 +94,58 @@ bytes_to_sectors (off_t size)
 /* In-memory inode. */
 struct inode
   {
-    struct list_elem elem;              /* Element in inode list. */
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+    // struct list_elem elem;           /* Element in inode list. */
+    struct hash_elem elem;              /* Element in open inode table. */
+/////////////////////////////////////////////////////////////////////////////
     block_sector_t sector;              /* Sector number of disk location. */
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
 //////////////////////////////// PJ4 EDITED /////////////////////////////////
-    // struct inode_disk data;          /* Inode content. */
-    struct lock extend_lock;            /* Lock for file extension. */
+    struct inode_disk data;             /* Inode content, kept in sync
+                                           with its sector. */
+    struct lock data_lock;              /* Serializes changes to data. */
+    off_t ra_next;                      /* End of last read. */
+    off_t ra_until;                     /* End of queued read-ahead. */
+    struct lock map_lock;               /* Protects map cache below. */
+    off_t map_base;                     /* First file sector mapped by
+                                           map_cache, or -1. */
+    block_sector_t map_cache[INDIRECT_BLOCK_ENTRIES]; /* Copy of last
+                                           index block used. */
+    struct lock range_lock;             /* Protects ranges below. */
+    struct condition range_cond;        /* Signaled when a range is
+                                           unlocked. */
+    struct list ranges;                 /* Locked byte_ranges. */
+    struct list_elem reap_elem;         /* Element in reap_list. */
+    struct lock dir_lock;               /* Serializes use of entries, if
+                                           a directory. */
 /////////////////////////////////////////////////////////////////////////////
   };
 
 //////////////////////////////// PJ4 EDITED /////////////////////////////////
-/* Read on-disk inode from buffer cache and save it to inode_disk. */
-static void
-get_disk_inode (const struct inode *inode, struct inode_disk *inode_disk)
+/* Byte range of an inode locked by a reader or writer. Ranges of
+   readers may overlap; a writer's range overlaps no other. */
+struct byte_range
+  {
+    struct list_elem elem;              /* Element in inode's ranges. */
+    off_t start;                        /* First byte. */
+    off_t end;                          /* One past last byte. */
+    bool write;                         /* Locked for writing? */
+  };
+
+static bool inode_reap_wait (void);
+static bool create (block_sector_t sector, off_t length, uint32_t flags);
+
+/* Return cache class of INODE's data sectors. */
+static inline enum cache_class
+data_class (const struct inode *inode)
 {
-  bc_read (inode->sector, inode_disk, 0, BLOCK_SECTOR_SIZE, 0);
+  return inode->data.flags & INODE_METADATA ? CACHE_METADATA : CACHE_DATA;
 }
+/////////////////////////////////////////////////////////////////////////////
 
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
 /* Check the access type of disk block and calculate index of blocks.
    Results are saved in sec_loc. */
 static void
@@ -116,21 +178,30 @@ locate_byte (off_t pos, struct sector_location *sec_loc)
     sec_loc->directness = OUT_LIMIT;
 }
 
-/* Return byte offset of map_table */
-static inline off_t
-map_table_offset (int index)
+/* Allocate an index block filled with zeros, as close to GOAL
+   as possible, and save its sector number to SECTORP. */
+static bool
+alloc_index_block (block_sector_t *sectorp, block_sector_t goal)
 {
-  return index * sizeof (block_sector_t);
+  struct buffer_head *bh;
+
+  if (!free_map_allocate_near (1, goal, sectorp))
+    return false;
+  bh = bc_get_new (*sectorp, CACHE_INDIRECT);
+  bc_release (bh, true);
+  return true;
 }
 
-/* Save sector number of new_sector to inode_disk. */
+/* Save sector number of new_sector to inode_disk. Index blocks
+   are updated in place in the buffer cache. */
 static bool
 register_sector (struct inode_disk *inode_disk, block_sector_t new_sector,
                  struct sector_location sec_loc)
 {
-  struct inode_indirect_block temp_block;
+  struct buffer_head *bh;
+  struct inode_indirect_block *ind_block;
   block_sector_t lower_table_sector;
-  uint8_t zeros[BLOCK_SECTOR_SIZE] = { 0, };
+  bool new_table;
 
   switch (sec_loc.directness)
   {
@@ -138,39 +209,37 @@ register_sector (struct inode_disk *inode_disk, block_sector_t new_sector,
       inode_disk->direct_map_table[sec_loc.index1] = new_sector;
       break;
     case INDIRECT:
-      if (inode_disk->indirect_block_sec <= 0)
-      {
-        if (!free_map_allocate (1, &inode_disk->indirect_block_sec))
-          return false;
-        bc_write (inode_disk->indirect_block_sec, zeros,
-                  0, BLOCK_SECTOR_SIZE, 0);
-      }
-      bc_write (inode_disk->indirect_block_sec, &new_sector,
-                0, sizeof (block_sector_t), map_table_offset (sec_loc.index1));
+      if (inode_disk->indirect_block_sec == 0
+          && !alloc_index_block (&inode_disk->indirect_block_sec,
+                                 new_sector))
+        return false;
+      bh = bc_get (inode_disk->indirect_block_sec, CACHE_INDIRECT);
+      ind_block = bh->data;
+      ind_block->map_table[sec_loc.index1] = new_sector;
+      bc_release (bh, true);
       break;
     case DOUBLE_INDIRECT:
-      if (inode_disk->double_indirect_block_sec <= 0)
-      {
-        if (!free_map_allocate (1, &inode_disk->double_indirect_block_sec))
-          return false;
-        memset (&temp_block, 0, sizeof temp_block);
-      }
-      else
-        bc_read (inode_disk->double_indirect_block_sec, &temp_block,
-                 0, BLOCK_SECTOR_SIZE, 0);
-
-      if (temp_block.map_table[sec_loc.index2] <= 0)
+      if (inode_disk->double_indirect_block_sec == 0
+          && !alloc_index_block (&inode_disk->double_indirect_block_sec,
+                                 new_sector))
+        return false;
+      bh = bc_get (inode_disk->double_indirect_block_sec, CACHE_INDIRECT);
+      ind_block = bh->data;
+      new_table = ind_block->map_table[sec_loc.index2] == 0;
+      if (new_table
+          && !alloc_index_block (&ind_block->map_table[sec_loc.index2],
+                                 new_sector))
       {
-        if (!free_map_allocate (1, &temp_block.map_table[sec_loc.index2]))
-          return false;
-        bc_write (temp_block.map_table[sec_loc.index2], zeros,
-                  0, BLOCK_SECTOR_SIZE, 0);
-        bc_write (inode_disk->double_indirect_block_sec, &temp_block.map_table,
-                  0, BLOCK_SECTOR_SIZE, 0);
+        bc_release (bh, false);
+        return false;
       }
+      lower_table_sector = ind_block->map_table[sec_loc.index2];
+      bc_release (bh, new_table);
 
-      bc_write (temp_block.map_table[sec_loc.index2], &new_sector,
-                0, sizeof (block_sector_t), map_table_offset (sec_loc.index1));
+      bh = bc_get (lower_table_sector, CACHE_INDIRECT);
+      ind_block = bh->data;
+      ind_block->map_table[sec_loc.index1] = new_sector;
+      bc_release (bh, true);
       break;
     default:
       return false;
@@ -178,10 +247,63 @@ register_sector (struct inode_disk *inode_disk, block_sector_t new_sector,
   return true;
 }
 
+/* Look up sector mapped to byte offset POS of INODE in its
+   index, whether or not POS is below end of file. The lowest
+   level index block covering POS is copied into map_cache of
+   INODE, so a sequential scan reads each index block once instead
+   of once per sector. inode_allocate() invalidates the copy after
+   it fills holes.
+   Returns 0 for a hole, -1 if POS is beyond the largest file. */
+static block_sector_t
+map_sector (struct inode *inode, off_t pos)
+{
+  struct sector_location sec_loc;
+  struct buffer_head *bh;
+  block_sector_t lower_table_sector;
+  block_sector_t result_sec;
+  off_t base;
+
+  locate_byte (pos, &sec_loc);
+  if (sec_loc.directness == NORMAL_DIRECT)
+    return inode->data.direct_map_table[sec_loc.index1];
+  if (sec_loc.directness == OUT_LIMIT)
+    return -1;
+
+  base = pos / BLOCK_SECTOR_SIZE - sec_loc.index1;
+  lock_acquire (&inode->map_lock);
+  if (base != inode->map_base)
+  {
+    if (sec_loc.directness == INDIRECT)
+      lower_table_sector = inode->data.indirect_block_sec;
+    else if (inode->data.double_indirect_block_sec == 0)
+      lower_table_sector = 0;
+    else
+    {
+      bh = bc_get (inode->data.double_indirect_block_sec, CACHE_INDIRECT);
+      lower_table_sector = ((struct inode_indirect_block *) bh->data)
+                             ->map_table[sec_loc.index2];
+      bc_release (bh, false);
+    }
+    if (lower_table_sector == 0)
+      memset (inode->map_cache, 0, sizeof inode->map_cache);
+    else
+    {
+      bh = bc_get (lower_table_sector, CACHE_INDIRECT);
+      memcpy (inode->map_cache, bh->data, sizeof inode->map_cache);
+      bc_release (bh, false);
+    }
+    inode->map_base = base;
+  }
+  result_sec = inode->map_cache[sec_loc.index1];
+  lock_release (&inode->map_lock);
+
+  return result_sec;
+}
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
    Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
+   POS, and 0 if POS lies in a hole that was never written. */
 /* old codes */
 // static block_sector_t
 // byte_to_sector (const struct inode *inode, off_t pos)
@@ -193,128 +315,442 @@ register_sector (struct inode_disk *inode_disk, block_sector_t new_sector,
     // return -1;
 // }
 static block_sector_t
-byte_to_sector (const struct inode_disk *inode_disk, off_t pos)
+byte_to_sector (struct inode *inode, off_t pos)
 {
-  block_sector_t result_sec;
+  if (pos >= inode->data.length)
+    return -1;
+  return map_sector (inode, pos);
+}
 
-  if (pos < inode_disk->length)
+
+/* Run of consecutive sectors waiting to be released. */
+struct sector_run
   {
-    block_sector_t lower_table_sector;
-    struct sector_location sec_loc;
-    locate_byte(pos, &sec_loc);
+    block_sector_t start;           /* First sector. */
+    size_t cnt;                     /* Number of sectors. */
+  };
 
-    switch (sec_loc.directness)
-    {
-      case NORMAL_DIRECT:
-        result_sec = inode_disk->direct_map_table[sec_loc.index1];
-        break;
-      case INDIRECT:
-        bc_read (inode_disk->indirect_block_sec, &result_sec,
-                 0, sizeof (block_sector_t), map_table_offset (sec_loc.index1));
-        break;
-      case DOUBLE_INDIRECT:
-        bc_read (inode_disk->double_indirect_block_sec, &lower_table_sector,
-                 0, sizeof (block_sector_t), map_table_offset (sec_loc.index2));
-        bc_read (lower_table_sector, &result_sec,
-                 0, sizeof (block_sector_t), map_table_offset (sec_loc.index1));
-        break;
-      default:
-        result_sec = -1;
-    }
-  }
-  else
-    result_sec = -1;
-    
-  return result_sec;
+/* Release sectors of RUN, if any, to free map. */
+static void
+release_run (struct sector_run *run)
+{
+  if (run->cnt > 0)
+    free_map_release (run->start, run->cnt);
+  run->cnt = 0;
 }
 
+/* Add SECTOR to RUN, releasing RUN first if SECTOR doesn't
+   extend it. */
+static void
+release_sector (struct sector_run *run, block_sector_t sector)
+{
+  if (run->cnt > 0 && sector == run->start + run->cnt)
+  {
+    run->cnt++;
+    return;
+  }
+  release_run (run);
+  run->start = sector;
+  run->cnt = 1;
+}
 
-/* Deallocate all disk block for inode_disk. */
+/* Deallocate all disk block for inode_disk. Consecutive sectors
+   are released together, one free map update per run. Holes are
+   0 entries and may appear anywhere in the index. */
 static void
 free_inode_sectors (struct inode_disk *inode_disk)
 {
   int i, j;
-  struct inode_indirect_block ind_block_1;
-  struct inode_indirect_block ind_block_2;
+  struct buffer_head *bh_1, *bh_2;
+  struct inode_indirect_block *ind_block_1;
+  struct inode_indirect_block *ind_block_2;
+  struct sector_run run = {0, 0};
+
+  if (inode_disk->flags & INODE_INLINE)
+    return;
+
+  for (i = 0; i < DIRECT_BLOCK_ENTRIES; i++)
+    if (inode_disk->direct_map_table[i] > 0)
+      release_sector (&run, inode_disk->direct_map_table[i]);
+
+  if (inode_disk->indirect_block_sec > 0){
+    bh_1 = bc_get (inode_disk->indirect_block_sec, CACHE_INDIRECT);
+    ind_block_1 = bh_1->data;
+    for (i = 0; i < INDIRECT_BLOCK_ENTRIES; i++)
+      if (ind_block_1->map_table[i] > 0)
+        release_sector (&run, ind_block_1->map_table[i]);
+    bc_release (bh_1, false);
+    release_sector (&run, inode_disk->indirect_block_sec);
+  }
 
   if (inode_disk->double_indirect_block_sec > 0)
   {
-    bc_read (inode_disk->double_indirect_block_sec, &ind_block_1,
-             0, BLOCK_SECTOR_SIZE, 0);
-    for (i = 0; i < INDIRECT_BLOCK_ENTRIES && ind_block_1.map_table[i] > 0; i++)
+    bh_1 = bc_get (inode_disk->double_indirect_block_sec, CACHE_INDIRECT);
+    ind_block_1 = bh_1->data;
+    for (i = 0; i < INDIRECT_BLOCK_ENTRIES; i++)
     {
-      bc_read (ind_block_1.map_table[i], &ind_block_2,
-               0, BLOCK_SECTOR_SIZE, 0);
-      for (j = 0; i < INDIRECT_BLOCK_ENTRIES && ind_block_2.map_table[j] > 0; j++)
-        free_map_release (ind_block_2.map_table[j], 1);
-      free_map_release (ind_block_1.map_table[i], 1);
+      if (ind_block_1->map_table[i] == 0)
+        continue;
+      bh_2 = bc_get (ind_block_1->map_table[i], CACHE_INDIRECT);
+      ind_block_2 = bh_2->data;
+      for (j = 0; j < INDIRECT_BLOCK_ENTRIES; j++)
+        if (ind_block_2->map_table[j] > 0)
+          release_sector (&run, ind_block_2->map_table[j]);
+      bc_release (bh_2, false);
+      release_sector (&run, ind_block_1->map_table[i]);
     }
-    free_map_release (inode_disk->double_indirect_block_sec, 1);
+    bc_release (bh_1, false);
+    release_sector (&run, inode_disk->double_indirect_block_sec);
   }
+  release_run (&run);
+}
 
-  if (inode_disk->indirect_block_sec > 0){
-    bc_read (inode_disk->indirect_block_sec, &ind_block_1,
-             0, BLOCK_SECTOR_SIZE, 0);
-    for (i = 0; i < INDIRECT_BLOCK_ENTRIES && ind_block_1.map_table[i] > 0; i++)
-      free_map_release (ind_block_1.map_table[i], 1);
-    free_map_release (inode_disk->indirect_block_sec, 1);
+/* Queue sectors following byte offset POS of sequentially read
+   INODE to read-ahead thread, up to READ_AHEAD_SECTORS ahead.
+   Sectors queued by an earlier call are skipped. */
+static void
+inode_read_ahead (struct inode *inode, off_t pos)
+{
+  off_t limit = pos + READ_AHEAD_SECTORS * BLOCK_SECTOR_SIZE;
+  off_t length = inode->data.length;
+  off_t ofs = ROUND_UP (pos, BLOCK_SECTOR_SIZE);
+
+  if (ofs < inode->ra_until)
+    ofs = inode->ra_until;
+  for (; ofs < limit && ofs < length; ofs += BLOCK_SECTOR_SIZE)
+  {
+    block_sector_t sector_idx = byte_to_sector (inode, ofs);
+
+    if (sector_idx != 0 && sector_idx != (block_sector_t) -1)
+      bc_read_ahead (sector_idx);
   }
+  inode->ra_until = ofs;
+}
 
-  for (i = 0; i < DIRECT_BLOCK_ENTRIES && inode_disk->direct_map_table[i] > 0; i++)
-    free_map_release (inode_disk->direct_map_table[i], 1);
+/* Return true if byte offset POS of INODE has no sector yet. */
+static bool
+is_hole (struct inode *inode, off_t pos)
+{
+  block_sector_t sector = map_sector (inode, pos);
+
+  return sector == 0 || sector == (block_sector_t) -1;
 }
 
-/* If start_pos < end_pos, then allocate
-   new disk block and update inode info. */
-bool
-inode_update_file_length (struct inode_disk *inode_disk,
-                          off_t start_pos, off_t end_pos)
+/* Zero bytes START up to END of INODE that lie in sectors already
+   allocated. Sectors past end of file may hold stale disk data,
+   since INODE_RESERVE_NO_ZERO leaves them unzeroed, so growth
+   clears the bytes it exposes before storing the new length.
+   Caller must hold data_lock. */
+static void
+zero_range (struct inode *inode, off_t start, off_t end)
 {
-  off_t size = end_pos - start_pos;
-  uint8_t zeroes[BLOCK_SECTOR_SIZE] = { 0, };
+  while (start < end)
+  {
+    off_t sector_end = ROUND_DOWN (start, BLOCK_SECTOR_SIZE)
+                       + BLOCK_SECTOR_SIZE;
+    off_t chunk_end = end < sector_end ? end : sector_end;
 
-  while (size > 0)
+    if (!is_hole (inode, start))
+    {
+      block_sector_t sector = map_sector (inode, start);
+      struct buffer_head *bh;
+
+      if (start % BLOCK_SECTOR_SIZE == 0 && chunk_end == sector_end)
+        bh = bc_get_new (sector, data_class (inode));
+      else
+      {
+        bh = bc_get (sector, data_class (inode));
+        memset (bh->data + start % BLOCK_SECTOR_SIZE, 0, chunk_end - start);
+      }
+      bc_release (bh, true);
+    }
+    start = chunk_end;
+  }
+}
+
+/* Allocate sectors for the holes among bytes START_POS up to
+   END_POS of INODE, which may lie past end of file. Sectors are
+   taken from the free map in runs as long as possible, so a large
+   append lands on consecutive sectors and costs one free map
+   update per run instead of per sector. With
+   INODE_RESERVE_CONTIGUOUS, all new sectors must come from a
+   single run. A new sector that the caller won't overwrite
+   completely is zeroed in cache without reading disk; without
+   INODE_RESERVE_NO_ZERO, every new sector is zeroed, and so is
+   every new sector before end of file. Does not change the file
+   length; new sectors left unzeroed past end of file are cleared
+   by zero_range() when the file grows. Set *ALLOCATED to true if any sector
+   was added to the index.
+   Caller must hold data_lock. Return false if disk is full. */
+static bool
+inode_allocate (struct inode *inode, off_t start_pos, off_t end_pos,
+                enum inode_reserve_flags flags, bool *allocated)
+{
+  size_t sector = start_pos / BLOCK_SECTOR_SIZE;
+  size_t end_sector = bytes_to_sectors (end_pos);
+  block_sector_t next = 0;        /* Next sector of reserved run. */
+  size_t avail = 0;               /* Sectors left in reserved run. */
+  block_sector_t goal;            /* Where new sectors should go. */
+  bool success = true;
+
+  ASSERT (lock_held_by_current_thread (&inode->data_lock));
+  *allocated = false;
+
+  /* Keep data right after the sector before it in the file, or
+     else right after the inode, so reading the file seeks less. */
+  goal = inode->sector + 1;
+  if (sector > 0 && !is_hole (inode, (sector - 1) * BLOCK_SECTOR_SIZE))
+    goal = map_sector (inode, (sector - 1) * BLOCK_SECTOR_SIZE) + 1;
+
+  if (flags & INODE_RESERVE_CONTIGUOUS)
   {
-    int sector_ofs = start_pos % BLOCK_SECTOR_SIZE;
-    int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
-    int chunk_size = size < sector_left ? size : sector_left;
-    if (chunk_size <= 0)
-      break;
+    size_t i;
 
-    if (sector_ofs == 0)
+    for (i = sector; i < end_sector; i++)
+      if (is_hole (inode, i * BLOCK_SECTOR_SIZE))
+        avail++;
+    if (avail > 0 && !free_map_allocate_near (avail, goal, &next))
+      return false;
+  }
+
+  for (; sector < end_sector; sector++)
+  {
+    off_t pos = sector * BLOCK_SECTOR_SIZE;
+    struct sector_location sec_loc;
+
+    if (!is_hole (inode, pos))
+      continue;
+    if (avail == 0)
     {
-      block_sector_t sector_idx;
-      struct sector_location sec_loc;
-      locate_byte (start_pos, &sec_loc);
+      size_t holes;
+
+      for (holes = 1; sector + holes < end_sector
+                      && is_hole (inode, pos + holes * BLOCK_SECTOR_SIZE);
+           holes++)
+        continue;
+      avail = free_map_allocate_run_near (holes, goal, &next);
+      /* Sectors of removed files may be about to be freed. */
+      if (avail == 0 && inode_reap_wait ())
+        avail = free_map_allocate_run_near (holes, goal, &next);
+      if (avail == 0)
+      {
+        success = false;
+        break;
+      }
+    }
 
-      if (!free_map_allocate (1, &sector_idx))
-        return false;
-      if (!register_sector (inode_disk, sector_idx, sec_loc))
-        return false;
-      bc_write (sector_idx, zeroes, 0, BLOCK_SECTOR_SIZE, 0);
+    locate_byte (pos, &sec_loc);
+    if (!register_sector (&inode->data, next, sec_loc))
+    {
+      success = false;
+      break;
     }
+    *allocated = true;
+    if (!(flags & INODE_RESERVE_NO_ZERO) || pos < inode->data.length
+        || pos < start_pos || pos + BLOCK_SECTOR_SIZE > end_pos)
+      bc_release (bc_get_new (next, data_class (inode)), true);
+    next++;
+    avail--;
+    goal = next;
+  }
+  if (avail > 0)
+    free_map_release (next, avail);
+
+  if (*allocated)
+  {
+    lock_acquire (&inode->map_lock);
+    inode->map_base = -1;
+    lock_release (&inode->map_lock);
+  }
+  return success;
+}
+
+/* Write in-memory copy of INODE's on-disk inode back to its
+   sector in buffer cache. Called after every change, under
+   data_lock. */
+static void
+inode_write_back (struct inode *inode)
+{
+  struct buffer_head *bh = bc_get_new (inode->sector, CACHE_INODE);
+
+  memcpy (bh->data, &inode->data, BLOCK_SECTOR_SIZE);
+  bc_release (bh, true);
+}
+
+/* Move inline data of INODE to a data sector of its own, so INODE
+   can grow past INLINE_DATA_SIZE. The sector is filled and mapped
+   before INODE_INLINE is cleared, so readers that don't hold
+   data_lock never see a half converted inode.
+   Caller must hold data_lock. Return false if disk is full. */
+static bool
+inode_uninline (struct inode *inode)
+{
+  struct buffer_head *bh;
+  block_sector_t sector;
+
+  ASSERT (lock_held_by_current_thread (&inode->data_lock));
+  ASSERT (inode->data.flags & INODE_INLINE);
 
-    /* Advance. */
-    size -= chunk_size;
-    start_pos += chunk_size;
+  /* An empty file needs no sector; all of it becomes a hole. */
+  sector = 0;
+  if (inode->data.length > 0)
+  {
+    if (!free_map_allocate_near (1, inode->sector + 1, &sector))
+      return false;
+    bh = bc_get_new (sector, data_class (inode));
+    memcpy (bh->data, inode->data.inline_data, inode->data.length);
+    bc_release (bh, true);
   }
 
-  inode_disk->length = end_pos;
+  memset (inode->data.inline_data, 0, sizeof inode->data.inline_data);
+  inode->data.direct_map_table[0] = sector;
+  barrier ();
+  inode->data.flags &= ~INODE_INLINE;
+  inode_write_back (inode);
   return true;
 }
 /////////////////////////////////////////////////////////////////////////////
 
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+/* old code */
 /* List of open inodes, so that opening a single inode twice
    returns the same `struct inode'. */
-static struct list open_inodes;
+// static struct list open_inodes;
+
+/* Open inodes, so that opening a single inode twice returns the
+   same `struct inode'. Sectors are spread over OPEN_INODE_STRIPES
+   hash tables, each with its own lock, so opens and closes of
+   different inodes seldom wait for each other. */
+struct open_inode_stripe
+  {
+    struct hash inodes;                 /* Sector -> open inode. */
+    struct lock lock;                   /* Protects inodes and open_cnt
+                                           of its members. */
+  };
+
+static struct open_inode_stripe open_inodes[OPEN_INODE_STRIPES];
+
+/* Removed inodes whose last opener closed them. Their sectors are
+   freed by the reaper thread, so closing one doesn't wait for a
+   walk of its whole index. */
+static struct list reap_list;
+static struct lock reap_lock;           /* Protects reap_list, reaping. */
+static struct condition reap_cond;      /* Signaled on push. */
+static struct condition reap_idle_cond; /* Signaled when batch done. */
+static bool reaping;                    /* Reaper is freeing a batch? */
+
+static void inode_reaper (void *aux);
+
+/* Hash function for open inode table. */
+static unsigned
+inode_hash_func (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct inode, elem)->sector);
+}
+
+/* Compare function for open inode table. */
+static bool
+inode_less_func (const struct hash_elem *a, const struct hash_elem *b,
+                 void *aux UNUSED)
+{
+  return hash_entry (a, struct inode, elem)->sector
+         < hash_entry (b, struct inode, elem)->sector;
+}
+
+/* Return the stripe of open inode table holding SECTOR. */
+static struct open_inode_stripe *
+open_inode_stripe (block_sector_t sector)
+{
+  return &open_inodes[sector % OPEN_INODE_STRIPES];
+}
 
 /* Initializes the inode module. */
 void
 inode_init (void)
 {
-  list_init (&open_inodes);
+  int i;
+
+  for (i = 0; i < OPEN_INODE_STRIPES; i++)
+  {
+    hash_init (&open_inodes[i].inodes, inode_hash_func, inode_less_func,
+               NULL);
+    lock_init (&open_inodes[i].lock);
+  }
+
+  list_init (&reap_list);
+  lock_init (&reap_lock);
+  cond_init (&reap_cond);
+  cond_init (&reap_idle_cond);
+  reaping = false;
+  thread_create ("inode_reaper", PRI_DEFAULT, inode_reaper, NULL);
 }
 
+/* Background thread that frees sectors of removed inodes. Each
+   batch takes every inode queued so far; the free map sectors
+   they touch are written once, by the next free_map_flush(). A
+   batch is one journal operation, which doesn't wait for commits
+   since operations that need free sectors wait for the batch. */
+static void
+inode_reaper (void *aux UNUSED)
+{
+  while (true)
+  {
+    struct list batch;
+
+    lock_acquire (&reap_lock);
+    while (list_empty (&reap_list))
+      cond_wait (&reap_cond, &reap_lock);
+    list_init (&batch);
+    list_splice (list_end (&batch), list_begin (&reap_list),
+                 list_end (&reap_list));
+    reaping = true;
+    lock_release (&reap_lock);
+
+    journal_begin_nowait ();
+    while (!list_empty (&batch))
+    {
+      struct inode *inode = list_entry (list_pop_front (&batch),
+                                        struct inode, reap_elem);
+
+      free_inode_sectors (&inode->data);
+      free_map_release (inode->sector, 1);
+      free (inode);
+    }
+    journal_end ();
+
+    lock_acquire (&reap_lock);
+    reaping = false;
+    cond_broadcast (&reap_idle_cond, &reap_lock);
+    lock_release (&reap_lock);
+  }
+}
+
+/* Wait until the reaper has freed every removed inode queued so
+   far. Return true if there was any to wait for. */
+static bool
+inode_reap_wait (void)
+{
+  bool waited = false;
+
+  lock_acquire (&reap_lock);
+  while (reaping || !list_empty (&reap_list))
+  {
+    waited = true;
+    cond_wait (&reap_idle_cond, &reap_lock);
+  }
+  lock_release (&reap_lock);
+  return waited;
+}
+
+/* Shuts down the inode module, finishing reclamation of removed
+   inodes so their sectors are free on disk. */
+void
+inode_done (void)
+{
+  inode_reap_wait ();
+}
+/////////////////////////////////////////////////////////////////////////////
+
 /* Initializes an inode with LENGTH bytes of data and
    writes the new inode to sector SECTOR on the file system
    device.
@@ -323,7 +759,26 @@ inode_init (void)
 bool
 inode_create (block_sector_t sector, off_t length)
 {
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  return create (sector, length, 0);
+}
+
+/* Like inode_create(), but the contents of the new file are file
+   system metadata, such as a directory or the free map, so its
+   changes go through the journal like inodes do. */
+bool
+inode_create_metadata (block_sector_t sector, off_t length)
+{
+  return create (sector, length, INODE_METADATA);
+}
+
+/* Creates an inode of LENGTH bytes with FLAGS in SECTOR. */
+static bool
+create (block_sector_t sector, off_t length, uint32_t flags)
+{
+/////////////////////////////////////////////////////////////////////////////
   struct inode_disk *disk_inode = NULL;
+  struct buffer_head *bh;
   bool success = false;
 
   ASSERT (length >= 0);
@@ -355,12 +810,19 @@ inode_create (block_sector_t sector, off_t length)
         // }
       // free (disk_inode);
 
+      /* A file small enough is kept inline, so creating it writes
+         a single sector. A larger file gets data sectors on first
+         write; until then the whole file is a hole that reads as
+         zeros. */
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
+      disk_inode->flags = flags;
+      if (length <= INLINE_DATA_SIZE)
+        disk_inode->flags |= INODE_INLINE;
 
-      if (length > 0)
-        inode_update_file_length (disk_inode, 0, length);
-      bc_write (sector, disk_inode, 0, BLOCK_SECTOR_SIZE, 0);
+      bh = bc_get_new (sector, CACHE_INODE);
+      memcpy (bh->data, disk_inode, BLOCK_SECTOR_SIZE);
+      bc_release (bh, true);
       free (disk_inode);
       success = true;
 /////////////////////////////////////////////////////////////////////////////
@@ -374,28 +836,37 @@ inode_create (block_sector_t sector, off_t length)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
   struct inode *inode;
-
-  /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e))
-    {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector)
-        {
-          inode_reopen (inode);
-          return inode;
-        }
-    }
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  struct open_inode_stripe *stripe = open_inode_stripe (sector);
+  struct inode key;
+  struct hash_elem *e;
+  struct buffer_head *bh;
+
+  /* Check whether this inode is already open. The stripe stays
+     locked until a new inode is inserted, so two threads opening
+     the same sector get the same inode. */
+  lock_acquire (&stripe->lock);
+  key.sector = sector;
+  e = hash_find (&stripe->inodes, &key.elem);
+  if (e != NULL)
+  {
+    inode = hash_entry (e, struct inode, elem);
+    inode->open_cnt++;
+    lock_release (&stripe->lock);
+    return inode;
+  }
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
   if (inode == NULL)
+  {
+    lock_release (&stripe->lock);
     return NULL;
+  }
+/////////////////////////////////////////////////////////////////////////////
 
   /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
@@ -403,7 +874,20 @@ inode_open (block_sector_t sector)
 //////////////////////////////// PJ4 EDITED /////////////////////////////////
   /* old code */
   // block_read (fs_device, inode->sector, &inode->data);
-  lock_init (&inode->extend_lock);
+  bh = bc_get (inode->sector, CACHE_INODE);
+  memcpy (&inode->data, bh->data, BLOCK_SECTOR_SIZE);
+  bc_release (bh, false);
+  lock_init (&inode->data_lock);
+  lock_init (&inode->map_lock);
+  inode->map_base = -1;
+  lock_init (&inode->range_lock);
+  cond_init (&inode->range_cond);
+  list_init (&inode->ranges);
+  lock_init (&inode->dir_lock);
+  inode->ra_next = 0;
+  inode->ra_until = 0;
+  hash_insert (&stripe->inodes, &inode->elem);
+  lock_release (&stripe->lock);
 /////////////////////////////////////////////////////////////////////////////
   return inode;
 }
@@ -412,8 +896,16 @@ inode_open (block_sector_t sector)
 struct inode *
 inode_reopen (struct inode *inode)
 {
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
   if (inode != NULL)
+  {
+    struct open_inode_stripe *stripe = open_inode_stripe (inode->sector);
+
+    lock_acquire (&stripe->lock);
     inode->open_cnt++;
+    lock_release (&stripe->lock);
+  }
+/////////////////////////////////////////////////////////////////////////////
   return inode;
 }
 
@@ -424,21 +916,42 @@ inode_get_inumber (const struct inode *inode)
   return inode->sector;
 }
 
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+/* Returns the lock a directory module holds while it uses the
+   entries of directory INODE. There is one per open inode, so
+   different directories are used in parallel. */
+struct lock *
+inode_dir_lock (struct inode *inode)
+{
+  return &inode->dir_lock;
+}
+/////////////////////////////////////////////////////////////////////////////
+
 /* Closes INODE and writes it to disk.
    If this was the last reference to INODE, frees its memory.
    If INODE was also a removed inode, frees its blocks. */
 void
 inode_close (struct inode *inode)
 {
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  struct open_inode_stripe *stripe;
+  bool last;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
 
+  stripe = open_inode_stripe (inode->sector);
+  lock_acquire (&stripe->lock);
+  last = --inode->open_cnt == 0;
+  if (last)
+    hash_delete (&stripe->inodes, &inode->elem);
+  lock_release (&stripe->lock);
+/////////////////////////////////////////////////////////////////////////////
+
   /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  if (last)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
 
       /* Deallocate blocks if removed. */
       if (inode->removed)
@@ -449,10 +962,12 @@ inode_close (struct inode *inode)
           // free_map_release (inode->data.start,
                             // bytes_to_sectors (inode->data.length));
 
-          struct inode_disk disk_inode;
-          get_disk_inode (inode, &disk_inode);
-          free_inode_sectors (&disk_inode);
-          free_map_release (inode->sector, 1);
+          /* The reaper frees its sectors and INODE itself. */
+          lock_acquire (&reap_lock);
+          list_push_back (&reap_list, &inode->reap_elem);
+          cond_signal (&reap_cond, &reap_lock);
+          lock_release (&reap_lock);
+          return;
 /////////////////////////////////////////////////////////////////////////////
         }
 
@@ -469,28 +984,170 @@ inode_remove (struct inode *inode)
   inode->removed = true;
 }
 
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+/* Lock bytes START to END of INODE in RANGE, for writing if WRITE
+   and for reading otherwise. Wait while a range overlapping it is
+   locked, unless both are locked for reading. */
+static void
+range_lock (struct inode *inode, struct byte_range *range,
+            off_t start, off_t end, bool write)
+{
+  struct list_elem *e;
+
+  range->start = start;
+  range->end = end;
+  range->write = write;
+
+  lock_acquire (&inode->range_lock);
+  for (e = list_begin (&inode->ranges); e != list_end (&inode->ranges); )
+  {
+    struct byte_range *r = list_entry (e, struct byte_range, elem);
+
+    if ((write || r->write) && start < r->end && r->start < end)
+    {
+      /* Ranges may have changed while waiting, so recheck all. */
+      cond_wait (&inode->range_cond, &inode->range_lock);
+      e = list_begin (&inode->ranges);
+    }
+    else
+      e = list_next (e);
+  }
+  list_push_back (&inode->ranges, &range->elem);
+  lock_release (&inode->range_lock);
+}
+
+/* Unlock RANGE of INODE and wake up threads waiting for it. */
+static void
+range_unlock (struct inode *inode, struct byte_range *range)
+{
+  lock_acquire (&inode->range_lock);
+  list_remove (&range->elem);
+  cond_broadcast (&inode->range_cond, &inode->range_lock);
+  lock_release (&inode->range_lock);
+}
+/////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+/* Position within an I/O vector. */
+struct iov_iter
+  {
+    const struct iovec *iov;            /* Current buffer. */
+    size_t ofs;                         /* Bytes of it already used. */
+  };
+
+/* Return total bytes in the IOVCNT buffers of IOV. */
+static off_t
+iov_length (const struct iovec *iov, int iovcnt)
+{
+  off_t length = 0;
+  int i;
+
+  for (i = 0; i < iovcnt; i++)
+    length += iov[i].iov_len;
+  return length;
+}
+
+/* Return next unused byte of ITER, skipping buffers used up, and
+   store bytes left in its buffer into *LEFT. There must be one. */
+static uint8_t *
+iov_next (struct iov_iter *iter, size_t *left)
+{
+  while (iter->ofs == iter->iov->iov_len)
+  {
+    iter->iov++;
+    iter->ofs = 0;
+  }
+  *left = iter->iov->iov_len - iter->ofs;
+  return (uint8_t *) iter->iov->iov_base + iter->ofs;
+}
+/////////////////////////////////////////////////////////////////////////////
+
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
 off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 {
-  uint8_t *buffer = buffer_;
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  struct iovec iov;
+
+  if (size <= 0)
+    return 0;
+  iov.iov_base = buffer_;
+  iov.iov_len = size;
+  return inode_readv (inode, &iov, 1, offset);
+}
+
+/* Reads from INODE into the IOVCNT buffers of IOV in turn,
+   starting at position OFFSET. The range is locked and the index
+   walked once for the whole request rather than once per buffer.
+   Returns the number of bytes actually read, which may be less
+   than requested if end of file is reached. */
+off_t
+inode_readv (struct inode *inode, const struct iovec *iov, int iovcnt,
+             off_t offset)
+{
+  struct iov_iter iter = {iov, 0};
+  off_t size = iov_length (iov, iovcnt);
   off_t bytes_read = 0;
   uint8_t *bounce = NULL;
-//////////////////////////////// PJ4 EDITED /////////////////////////////////
-  struct inode_disk disk_inode;
-  get_disk_inode (inode, &disk_inode);
+  bool sequential = offset == inode->ra_next;
+  struct byte_range range;
+  off_t length;
+
+  if (size <= 0)
+    return 0;
+
+  /* Readers wait only for writers of overlapping bytes, which may
+     be growing the file into sectors not yet zeroed. */
+  range_lock (inode, &range, offset, offset + size, false);
+
+  /* Inline data is read from the inode, without another sector.
+     It changes under data_lock, and a writer may move it out to a
+     sector meanwhile, so check again with the lock held. */
+  if (inode->data.flags & INODE_INLINE)
+  {
+    lock_acquire (&inode->data_lock);
+    if (inode->data.flags & INODE_INLINE)
+    {
+      length = inode->data.length;
+      while (size > 0 && offset < length)
+      {
+        size_t buffer_left;
+        uint8_t *buffer = iov_next (&iter, &buffer_left);
+        off_t chunk_size = length - offset;
+
+        if (chunk_size > size)
+          chunk_size = size;
+        if ((size_t) chunk_size > buffer_left)
+          chunk_size = buffer_left;
+        memcpy (buffer, inode->data.inline_data + offset, chunk_size);
+        iter.ofs += chunk_size;
+        size -= chunk_size;
+        offset += chunk_size;
+        bytes_read += chunk_size;
+      }
+      lock_release (&inode->data_lock);
+      range_unlock (inode, &range);
+      return bytes_read;
+    }
+    lock_release (&inode->data_lock);
+  }
+  length = inode_length (inode);
 
   while (size > 0)
     {
-      /* Disk sector to read, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (&disk_inode, offset);
+      /* Disk sector to read, starting byte offset within sector.
+         Reading doesn't need data_lock: a write fills a hole or
+         grows the file before it stores any data there. */
+      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      size_t buffer_left;
+      uint8_t *buffer;
 /////////////////////////////////////////////////////////////////////////////
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
+      off_t inode_left = length - offset;
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
       int min_left = inode_left < sector_left ? inode_left : sector_left;
 
@@ -500,6 +1157,11 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
         break;
 
 //////////////////////////////// PJ4 EDITED /////////////////////////////////
+      /* Stop at end of current buffer, too. */
+      buffer = iov_next (&iter, &buffer_left);
+      if ((size_t) chunk_size > buffer_left)
+        chunk_size = buffer_left;
+
       /* old codes */
       // if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
         // {
@@ -519,7 +1181,12 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
           // block_read (fs_device, sector_idx, bounce);
           // memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
         // }
-      bc_read (sector_idx, buffer, bytes_read, chunk_size, sector_ofs);
+      if (sector_idx == 0) /* Hole. */
+        memset (buffer, 0, chunk_size);
+      else
+        bc_read (sector_idx, buffer, 0, chunk_size, sector_ofs,
+                 data_class (inode));
+      iter.ofs += chunk_size;
 /////////////////////////////////////////////////////////////////////////////
 
 
@@ -529,6 +1196,14 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       bytes_read += chunk_size;
     }
   free (bounce);
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  range_unlock (inode, &range);
+  inode->ra_next = offset;
+  if (sequential)
+    inode_read_ahead (inode, offset);
+  else
+    inode->ra_until = 0;
+/////////////////////////////////////////////////////////////////////////////
 
   return bytes_read;
 }
@@ -543,39 +1218,115 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset)
 {
 //////////////////////////////// PJ4 EDITED /////////////////////////////////
-  const uint8_t *buffer = buffer_;
+  struct iovec iov;
+
+  if (size <= 0)
+    return 0;
+  iov.iov_base = (void *) buffer_;
+  iov.iov_len = size;
+  return inode_writev (inode, &iov, 1, offset);
+}
+
+/* Writes the IOVCNT buffers of IOV in turn into INODE, starting
+   at OFFSET. Holes in the whole range are filled and the file is
+   grown in a single step, and the range is locked once, so the
+   write is atomic to overlapping readers and writers.
+   Returns the number of bytes actually written, which may be less
+   than requested if the disk is full. */
+off_t
+inode_writev (struct inode *inode, const struct iovec *iov, int iovcnt,
+              off_t offset)
+{
+  struct iov_iter iter = {iov, 0};
+  off_t size = iov_length (iov, iovcnt);
   off_t bytes_written = 0;
   // uint8_t *bounce = NULL;
 
-  if (inode->deny_write_cnt)
+  struct byte_range range;
+  off_t length;
+  bool changed;
+
+  if (inode->deny_write_cnt || size <= 0)
     return 0;
 
-  struct inode_disk disk_inode;
-  get_disk_inode (inode, &disk_inode);
+  /* Index, inode and metadata file changes commit together. */
+  journal_begin ();
+
+  /* Writers of disjoint ranges run in parallel, and a write is
+     atomic to overlapping readers and writers. */
+  range_lock (inode, &range, offset, offset + size, true);
 
-  lock_acquire (&inode->extend_lock);
-  int old_length = disk_inode.length;
-  int write_end = offset + size - 1;
-  if (write_end > old_length - 1)
-    inode_update_file_length (&disk_inode, old_length, write_end);
-  lock_release (&inode->extend_lock);
+  /* Fill holes in written range, and grow file if writing past
+     EOF. If disk fills up, only the bytes before the first hole
+     left are written. Only this step is serialized. */
+  lock_acquire (&inode->data_lock);
+  if (inode->data.flags & INODE_INLINE)
+  {
+    /* Still fits inline: one update of the inode sector. */
+    if (offset + size <= INLINE_DATA_SIZE)
+    {
+      while (bytes_written < size)
+      {
+        size_t chunk_size;
+        uint8_t *buffer = iov_next (&iter, &chunk_size);
+
+        memcpy (inode->data.inline_data + offset + bytes_written, buffer,
+                chunk_size);
+        iter.ofs += chunk_size;
+        bytes_written += chunk_size;
+      }
+      if (offset + size > inode->data.length)
+        inode->data.length = offset + size;
+      inode_write_back (inode);
+      lock_release (&inode->data_lock);
+      range_unlock (inode, &range);
+      journal_end ();
+      return size;
+    }
+    if (!inode_uninline (inode))
+    {
+      lock_release (&inode->data_lock);
+      range_unlock (inode, &range);
+      journal_end ();
+      return 0;
+    }
+  }
+  if (inode_allocate (inode, offset, offset + size, INODE_RESERVE_NO_ZERO,
+                      &changed)
+      && offset + size > inode->data.length)
+  {
+    zero_range (inode, inode->data.length, offset);
+    inode->data.length = offset + size;
+    changed = true;
+  }
+  if (changed)
+    inode_write_back (inode);
+  length = inode->data.length;
+  lock_release (&inode->data_lock);
 
   while (size > 0)
     {
       /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (&disk_inode, offset);
+      block_sector_t sector_idx = byte_to_sector (inode, offset);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
+      size_t buffer_left;
+      uint8_t *buffer;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
+      off_t inode_left = length - offset;
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
       int min_left = inode_left < sector_left ? inode_left : sector_left;
 
       /* Number of bytes to actually write into this sector. */
       int chunk_size = size < min_left ? size : min_left;
-      if (chunk_size <= 0)
+      if (chunk_size <= 0 || sector_idx == 0)
         break;
 
+      /* Stop at end of current buffer, too. */
+      buffer = iov_next (&iter, &buffer_left);
+      if ((size_t) chunk_size > buffer_left)
+        chunk_size = buffer_left;
+
       /* old codes */
       // if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
         // {
@@ -602,7 +1353,9 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
           // memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
           // block_write (fs_device, sector_idx, bounce);
         // }
-      bc_write (sector_idx, buffer, bytes_written, chunk_size, sector_ofs);
+      bc_write (sector_idx, buffer, 0, chunk_size, sector_ofs,
+                data_class (inode));
+      iter.ofs += chunk_size;
 
       /* Advance. */
       size -= chunk_size;
@@ -610,7 +1363,8 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       bytes_written += chunk_size;
     }
   // free (bounce);
-  bc_write (inode->sector, &disk_inode, 0, BLOCK_SECTOR_SIZE, 0);
+  range_unlock (inode, &range);
+  journal_end ();
 /////////////////////////////////////////////////////////////////////////////
   return bytes_written;
 }
@@ -640,9 +1394,90 @@ off_t
 inode_length (const struct inode *inode)
 {
 //////////////////////////////// PJ4 EDITED /////////////////////////////////
-  // return inode->data.length;
-  struct inode_disk disk_inode;
-  get_disk_inode (inode, &disk_inode);
-  return disk_inode.length;
+  /* Growth stores the new length last, so no lock is needed. */
+  return inode->data.length;
 /////////////////////////////////////////////////////////////////////////////
 }
+
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+/* Reserve sectors for the first LENGTH bytes of INODE, so later
+   writes there need no allocation. FLAGS is a combination of
+   INODE_RESERVE_*. Unless INODE_RESERVE_KEEP_SIZE is given, INODE
+   is extended to LENGTH bytes if shorter. INODE_RESERVE_NO_ZERO
+   requires INODE_RESERVE_KEEP_SIZE, so unzeroed sectors stay past
+   end of file until written. Without INODE_RESERVE_CONTIGUOUS,
+   sectors are reserved RESERVE_STEP bytes per journal handle, so
+   a large reservation doesn't outgrow the log.
+   Return true if successful; on failure some sectors may stay
+   reserved. */
+bool
+inode_reserve (struct inode *inode, off_t length,
+               enum inode_reserve_flags flags)
+{
+  off_t step = flags & INODE_RESERVE_CONTIGUOUS ? length : RESERVE_STEP;
+  off_t pos = 0;
+  bool changed;
+  bool success = true;
+
+  if (inode->deny_write_cnt)
+    return false;
+  if ((flags & INODE_RESERVE_NO_ZERO) && !(flags & INODE_RESERVE_KEEP_SIZE))
+    return false;
+
+  journal_begin ();
+  lock_acquire (&inode->data_lock);
+  if (inode->data.flags & INODE_INLINE)
+  {
+    if (length <= INLINE_DATA_SIZE)
+    {
+      /* Nothing to allocate; inline bytes past EOF are zeros. */
+      if (!(flags & INODE_RESERVE_KEEP_SIZE) && length > inode->data.length)
+      {
+        inode->data.length = length;
+        inode_write_back (inode);
+      }
+      lock_release (&inode->data_lock);
+      journal_end ();
+      return true;
+    }
+    if (!inode_uninline (inode))
+    {
+      lock_release (&inode->data_lock);
+      journal_end ();
+      return false;
+    }
+  }
+  while (success)
+  {
+    off_t end = length - pos > step ? pos + step : length;
+
+    success = inode_allocate (inode, pos, end, flags, &changed);
+    pos = end;
+    if (!success || pos == length)
+      break;
+    if (changed)
+      inode_write_back (inode);
+
+    /* End the handle between steps, so journal_begin() can
+       commit what is reserved so far. */
+    lock_release (&inode->data_lock);
+    journal_end ();
+    journal_begin ();
+    lock_acquire (&inode->data_lock);
+  }
+  if (success && !(flags & INODE_RESERVE_KEEP_SIZE)
+      && length > inode->data.length)
+  {
+    /* Sectors reserved earlier without zeroing come into view. */
+    zero_range (inode, inode->data.length, length);
+    inode->data.length = length;
+    changed = true;
+  }
+  if (changed)
+    inode_write_back (inode);
+  lock_release (&inode->data_lock);
+  journal_end ();
+
+  return success;
+}
+/////////////////////////////////////////////////////////////////////////////
@@ -6,6 +6,10 @@
 #include "devices/block.h"
 
 struct bitmap;
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+struct iovec;
+struct lock;
+/////////////////////////////////////////////////////////////////////////////
 
 void inode_init (void);
 bool inode_create (block_sector_t, off_t);
@@ -20,9 +24,24 @@ void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
 //////////////////////////////// PJ4 EDITED /////////////////////////////////
-struct inode_disk;
-bool inode_update_file_length (struct inode_disk *inode_disk,
-                               off_t start_pos, off_t end_pos);
+
+/* Flags for inode_reserve(). */
+enum inode_reserve_flags
+  {
+    INODE_RESERVE_CONTIGUOUS = 001, /* Take new sectors in one run. */
+    INODE_RESERVE_NO_ZERO = 002,    /* Leave new sectors unzeroed;
+                                       needs INODE_RESERVE_KEEP_SIZE. */
+    INODE_RESERVE_KEEP_SIZE = 004   /* Don't extend the file. */
+  };
+
+bool inode_create_metadata (block_sector_t, off_t);
+struct lock *inode_dir_lock (struct inode *);
+bool inode_reserve (struct inode *, off_t length, enum inode_reserve_flags);
+off_t inode_readv (struct inode *, const struct iovec *, int iovcnt,
+                   off_t offset);
+off_t inode_writev (struct inode *, const struct iovec *, int iovcnt,
+                    off_t offset);
+void inode_done (void);
 /////////////////////////////////////////////////////////////////////////////
 
 #endif /* filesys/inode.h */
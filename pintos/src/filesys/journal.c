@@ -0,0 +1,834 @@
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+#include "filesys/journal.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* The journal is the JOURNAL_SECTORS sectors from JOURNAL_SECTOR:
+   a superblock, then the log. A transaction in the log is one or
+   more descriptor blocks, each followed by the images of the
+   sectors it lists, and a commit block, written one after
+   another. */
+#define JOURNAL_MAGIC 0x4a524e4c        /* Superblock, "JRNL". */
+#define JOURNAL_DESC_MAGIC 0x4a445343   /* Descriptor block, "JDSC". */
+#define JOURNAL_COMMIT_MAGIC 0x4a434d54 /* Commit block, "JCMT". */
+#define JOURNAL_DESC_ENTRIES 125        /* Entries in descriptor block. */
+#define JOURNAL_REVOKE 0x80000000       /* Entry flag: sector was freed. */
+#define JOURNAL_TXN_SECTORS 32          /* Running transaction size at
+                                           which journal_begin() commits. */
+
+/* Superblock, the first sector of the journal. */
+struct journal_super
+{
+  uint32_t magic;             /* JOURNAL_MAGIC. */
+  uint32_t seq;               /* Sequence number of first transaction
+                                 in log. */
+  uint8_t unused[BLOCK_SECTOR_SIZE - 8];
+};
+
+/* First sector of a transaction in log. Each entry is the home
+   sector of the next image that follows, or, with JOURNAL_REVOKE,
+   a sector freed by the transaction that has no image. */
+struct journal_desc
+{
+  uint32_t magic;             /* JOURNAL_DESC_MAGIC. */
+  uint32_t seq;               /* Sequence number of transaction. */
+  uint32_t cnt;               /* Number of entries. */
+  block_sector_t entries[JOURNAL_DESC_ENTRIES];
+};
+
+/* Last sector of a transaction in log. A transaction without a
+   matching commit block was cut short by a crash and is ignored. */
+struct journal_commit_block
+{
+  uint32_t magic;             /* JOURNAL_COMMIT_MAGIC. */
+  uint32_t seq;               /* Sequence number of transaction. */
+  uint32_t checksum;          /* Of descriptor and images. */
+  uint8_t unused[BLOCK_SECTOR_SIZE - 12];
+};
+
+/* Copies of a metadata sector held by the journal. Once a sector
+   is in the journal, only the journal writes it home: the running
+   copy reaches the log on commit, and the logged copy reaches home
+   on checkpoint. */
+struct journal_block
+{
+  block_sector_t sector;      /* Home sector. */
+  uint8_t *running;           /* Copy in running transaction, or NULL. */
+  uint8_t *committing;        /* Copy being written to log, or NULL. */
+  uint8_t *logged;            /* Copy in log but not at home, or NULL. */
+  bool revoke;                /* Running transaction freed sector. */
+  bool stale;                 /* Freed after committing copy was taken. */
+  bool queued;                /* In running transaction? */
+  bool in_commit;             /* In transaction being committed? */
+  struct hash_elem hash_elem; /* Element for journal_blocks. */
+  struct list_elem elem;      /* Element for journal_running. */
+  struct list_elem logged_elem; /* Element for journal_logged. */
+  struct list_elem commit_elem; /* Element for journal_committing. */
+};
+
+static struct hash journal_blocks;    /* Sector -> journal_block. */
+static struct list journal_running;   /* Blocks of running transaction. */
+static size_t journal_running_cnt;    /* Length of journal_running. */
+static struct list journal_logged;    /* Blocks with a logged copy. */
+static int journal_active;            /* Handles open now. */
+static unsigned journal_started;      /* Handles opened so far. */
+static bool journal_frozen;           /* Commit waits for handles to end,
+                                         so new ones must wait. */
+static struct lock journal_lock;      /* Protects everything above. */
+static struct condition journal_cond; /* Signaled when the last handle
+                                         ends or commit unfreezes. */
+
+static unsigned long long journal_commits;     /* Transactions logged. */
+static unsigned long long journal_log_writes;  /* Sectors written to log. */
+static unsigned long long journal_checkpoints; /* Copies written home. */
+
+/* Log state, protected by journal_commit_lock, which also keeps
+   one commit at a time. */
+static struct lock journal_commit_lock;
+static bool journal_ready;            /* Open and not done? */
+static uint32_t journal_seq;          /* Sequence number of next
+                                         transaction. */
+static size_t journal_head;           /* Next free sector of log, counted
+                                         from JOURNAL_SECTOR. */
+static struct list journal_committing; /* Blocks of transaction being
+                                          committed. */
+static struct journal_super journal_super_block;
+static struct journal_desc journal_desc_block;
+static struct journal_commit_block journal_commit_block;
+static uint8_t journal_image[BLOCK_SECTOR_SIZE];
+
+static unsigned journal_hash_func (const struct hash_elem *e, void *aux);
+static bool journal_less_func (const struct hash_elem *a,
+                               const struct hash_elem *b, void *aux);
+static bool journal_sector_less (const struct list_elem *a,
+                                 const struct list_elem *b, void *aux);
+static void start_handle (bool wait);
+
+/* Initialize journal. Must be called before the buffer cache is
+   used; the log is read by journal_open(). */
+void
+journal_init (void)
+{
+  ASSERT (sizeof (struct journal_super) == BLOCK_SECTOR_SIZE);
+  ASSERT (sizeof (struct journal_desc) == BLOCK_SECTOR_SIZE);
+  ASSERT (sizeof (struct journal_commit_block) == BLOCK_SECTOR_SIZE);
+
+  hash_init (&journal_blocks, journal_hash_func, journal_less_func, NULL);
+  list_init (&journal_running);
+  list_init (&journal_logged);
+  list_init (&journal_committing);
+  lock_init (&journal_lock);
+  cond_init (&journal_cond);
+  lock_init (&journal_commit_lock);
+  journal_running_cnt = 0;
+  journal_active = 0;
+  journal_started = 0;
+  journal_frozen = false;
+  journal_ready = false;
+}
+
+/* Hash function for journal_blocks. */
+static unsigned
+journal_hash_func (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct journal_block, hash_elem)->sector);
+}
+
+/* Compare function for journal_blocks. */
+static bool
+journal_less_func (const struct hash_elem *a, const struct hash_elem *b,
+                   void *aux UNUSED)
+{
+  return hash_entry (a, struct journal_block, hash_elem)->sector
+         < hash_entry (b, struct journal_block, hash_elem)->sector;
+}
+
+/* Compare sectors of two journal_blocks in journal_logged. */
+static bool
+journal_sector_less (const struct list_elem *a, const struct list_elem *b,
+                     void *aux UNUSED)
+{
+  return list_entry (a, struct journal_block, logged_elem)->sector
+         < list_entry (b, struct journal_block, logged_elem)->sector;
+}
+
+/* Return journal block of SECTOR, or NULL if the journal holds no
+   copy of it. Caller must hold journal_lock. */
+static struct journal_block *
+find_block (block_sector_t sector)
+{
+  struct journal_block key;
+  struct hash_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+  key.sector = sector;
+  e = hash_find (&journal_blocks, &key.hash_elem);
+
+  return e != NULL ? hash_entry (e, struct journal_block, hash_elem) : NULL;
+}
+
+/* Free JB if nothing refers to it anymore.
+   Caller must hold journal_lock. */
+static void
+drop_block (struct journal_block *jb)
+{
+  if (jb->running == NULL && jb->committing == NULL && jb->logged == NULL
+      && !jb->revoke && !jb->queued && !jb->in_commit)
+  {
+    hash_delete (&journal_blocks, &jb->hash_elem);
+    free (jb);
+  }
+}
+
+/* Add JB to running transaction. Caller must hold journal_lock. */
+static void
+queue_block (struct journal_block *jb)
+{
+  if (!jb->queued)
+  {
+    list_push_back (&journal_running, &jb->elem);
+    jb->queued = true;
+    journal_running_cnt++;
+  }
+}
+
+/* Drop every copy of JB, so the journal neither writes it home
+   nor returns it from journal_read(). A copy being committed is
+   dropped once its commit is done. Caller must hold journal_lock. */
+static void
+forget_copies (struct journal_block *jb)
+{
+  free (jb->running);
+  jb->running = NULL;
+  if (jb->logged != NULL)
+  {
+    list_remove (&jb->logged_elem);
+    free (jb->logged);
+    jb->logged = NULL;
+  }
+  if (jb->committing != NULL)
+    jb->stale = true;
+}
+
+/* Write superblock saying the log starts at transaction
+   journal_seq, which empties the log. Caller must hold
+   journal_commit_lock, and every logged copy must be home. */
+static void
+write_super (void)
+{
+  memset (&journal_super_block, 0, sizeof journal_super_block);
+  journal_super_block.magic = JOURNAL_MAGIC;
+  journal_super_block.seq = journal_seq;
+  block_write (fs_device, JOURNAL_SECTOR, &journal_super_block);
+  journal_head = 1;
+}
+
+/* Write every logged copy home, in sector order so the disk seeks
+   less. Caller must hold journal_lock, so nobody reads or frees a
+   copy while it is written. */
+static void
+checkpoint (void)
+{
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+  list_sort (&journal_logged, journal_sector_less, NULL);
+  while (!list_empty (&journal_logged))
+  {
+    struct journal_block *jb = list_entry (list_pop_front (&journal_logged),
+                                           struct journal_block,
+                                           logged_elem);
+
+    block_write (fs_device, jb->sector, jb->logged);
+    free (jb->logged);
+    jb->logged = NULL;
+    journal_checkpoints++;
+    drop_block (jb);
+  }
+}
+
+/* Write every copy the journal holds home and empty the log, for
+   a transaction too large for the whole log or at shutdown.
+   Running copies go home last and not atomically, after the log
+   is emptied, so replay can't overwrite them with older images.
+   Caller must hold journal_commit_lock and journal_lock. */
+static void
+write_all_home (void)
+{
+  checkpoint ();
+  write_super ();
+  while (!list_empty (&journal_running))
+  {
+    struct journal_block *jb = list_entry (list_pop_front (&journal_running),
+                                           struct journal_block, elem);
+
+    jb->queued = false;
+    jb->revoke = false;
+    if (jb->running != NULL)
+    {
+      block_write (fs_device, jb->sector, jb->running);
+      free (jb->running);
+      jb->running = NULL;
+      journal_checkpoints++;
+    }
+    drop_block (jb);
+  }
+  journal_running_cnt = 0;
+}
+
+/* Return log sectors taken by a transaction of CNT entries,
+   DATA_CNT of them with images. */
+static size_t
+txn_sectors (size_t cnt, size_t data_cnt)
+{
+  return DIV_ROUND_UP (cnt, JOURNAL_DESC_ENTRIES) + data_cnt + 1;
+}
+
+/* Write the CNT blocks of journal_committing, DATA_CNT of them
+   with images, to log as transaction journal_seq. Each descriptor
+   lists up to JOURNAL_DESC_ENTRIES blocks and is followed by their
+   images; one commit block at the end covers them all, so replay
+   takes all or none. Everything goes to consecutive sectors.
+   Caller must hold journal_commit_lock. */
+static void
+write_txn (size_t cnt, size_t data_cnt)
+{
+  struct list_elem *e = list_begin (&journal_committing);
+  block_sector_t pos;
+  uint32_t checksum = 0;
+
+  /* Out of log space: move logged copies home and start over. */
+  if (journal_head + txn_sectors (cnt, data_cnt) > JOURNAL_SECTORS)
+  {
+    lock_acquire (&journal_lock);
+    checkpoint ();
+    lock_release (&journal_lock);
+    write_super ();
+  }
+
+  pos = JOURNAL_SECTOR + journal_head;
+  while (e != list_end (&journal_committing))
+  {
+    struct list_elem *first = e;
+    struct journal_block *jb;
+    size_t n;
+
+    journal_desc_block.magic = JOURNAL_DESC_MAGIC;
+    journal_desc_block.seq = journal_seq;
+    for (n = 0;
+         n < JOURNAL_DESC_ENTRIES && e != list_end (&journal_committing);
+         n++, e = list_next (e))
+    {
+      jb = list_entry (e, struct journal_block, commit_elem);
+      journal_desc_block.entries[n] = jb->sector | (jb->committing == NULL
+                                                    ? JOURNAL_REVOKE : 0);
+    }
+    journal_desc_block.cnt = n;
+    block_write (fs_device, pos++, &journal_desc_block);
+    checksum = checksum * 31 + hash_bytes (&journal_desc_block,
+                                           sizeof journal_desc_block);
+
+    for (; first != e; first = list_next (first))
+    {
+      jb = list_entry (first, struct journal_block, commit_elem);
+      if (jb->committing != NULL)
+      {
+        block_write (fs_device, pos++, jb->committing);
+        checksum = checksum * 31 + hash_bytes (jb->committing,
+                                               BLOCK_SECTOR_SIZE);
+      }
+    }
+  }
+
+  memset (&journal_commit_block, 0, sizeof journal_commit_block);
+  journal_commit_block.magic = JOURNAL_COMMIT_MAGIC;
+  journal_commit_block.seq = journal_seq;
+  journal_commit_block.checksum = checksum;
+  block_write (fs_device, pos++, &journal_commit_block);
+
+  journal_head = pos - JOURNAL_SECTOR;
+  journal_seq++;
+}
+
+/* Commit running transaction: changes of every operation that
+   ended since the last commit reach the log in one sequential
+   write, so operations share the cost (group commit). New
+   operations wait until the transaction is taken, so it holds no
+   half done operation. Operations begun with
+   journal_begin_nowait() don't wait, so the free map, whose
+   changes join the transaction first, is written again until
+   none began meanwhile. Caller must not hold a handle. */
+void
+journal_commit (void)
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+  unsigned started;
+  size_t cnt = 0;
+  size_t data_cnt = 0;
+
+  ASSERT (t->journal_depth == 0);
+  lock_acquire (&journal_commit_lock);
+  if (!journal_ready)
+  {
+    lock_release (&journal_commit_lock);
+    return;
+  }
+
+  lock_acquire (&journal_lock);
+  journal_frozen = true;
+  do
+  {
+    while (journal_active > 0)
+      cond_wait (&journal_cond, &journal_lock);
+    started = journal_started;
+    lock_release (&journal_lock);
+
+    /* Writing free map may begin a handle; it must not wait. */
+    t->journal_depth++;
+    free_map_flush ();
+    t->journal_depth--;
+
+    lock_acquire (&journal_lock);
+  }
+  while (journal_active > 0 || journal_started != started);
+  journal_frozen = false;
+  cond_broadcast (&journal_cond, &journal_lock);
+
+  for (e = list_begin (&journal_running); e != list_end (&journal_running);
+       e = list_next (e))
+  {
+    struct journal_block *jb = list_entry (e, struct journal_block, elem);
+
+    if (jb->revoke || jb->running != NULL)
+      cnt++;
+    if (!jb->revoke && jb->running != NULL)
+      data_cnt++;
+  }
+  if (txn_sectors (cnt, data_cnt) > JOURNAL_SECTORS - 1)
+  {
+    /* Too large to log atomically. journal_begin() commits long
+       before this and inode_reserve() reserves in steps, so only
+       many large operations at once get here. */
+    write_all_home ();
+    lock_release (&journal_lock);
+    lock_release (&journal_commit_lock);
+    return;
+  }
+  while (!list_empty (&journal_running))
+  {
+    struct journal_block *jb = list_entry (list_pop_front (&journal_running),
+                                           struct journal_block, elem);
+
+    jb->queued = false;
+    if (jb->revoke)
+      jb->revoke = false;
+    else if (jb->running != NULL)
+    {
+      jb->committing = jb->running;
+      jb->running = NULL;
+    }
+    else
+    {
+      drop_block (jb);
+      continue;
+    }
+    jb->in_commit = true;
+    list_push_back (&journal_committing, &jb->commit_elem);
+  }
+  journal_running_cnt = 0;
+  lock_release (&journal_lock);
+
+  if (cnt == 0)
+  {
+    lock_release (&journal_commit_lock);
+    return;
+  }
+  write_txn (cnt, data_cnt);
+
+  /* Committed copies are now logged; they go home on checkpoint. */
+  lock_acquire (&journal_lock);
+  while (!list_empty (&journal_committing))
+  {
+    struct journal_block *jb;
+
+    jb = list_entry (list_pop_front (&journal_committing),
+                     struct journal_block, commit_elem);
+    jb->in_commit = false;
+    if (jb->committing != NULL && jb->stale)
+      free (jb->committing);
+    else if (jb->committing != NULL)
+    {
+      if (jb->logged != NULL)
+        free (jb->logged);
+      else
+        list_push_back (&journal_logged, &jb->logged_elem);
+      jb->logged = jb->committing;
+    }
+    jb->committing = NULL;
+    jb->stale = false;
+    drop_block (jb);
+  }
+  journal_commits++;
+  journal_log_writes += txn_sectors (cnt, data_cnt);
+  lock_release (&journal_lock);
+  lock_release (&journal_commit_lock);
+}
+
+/* Begin an operation that changes metadata. Its changes commit
+   together, with all changes of operations running alongside.
+   Nested calls join the outer operation. Must be called before
+   taking any file system lock, since it may wait for a commit. */
+void
+journal_begin (void)
+{
+  if (thread_current ()->journal_depth == 0
+      && journal_running_cnt >= JOURNAL_TXN_SECTORS)
+    journal_commit ();
+  start_handle (true);
+}
+
+/* Like journal_begin(), but never waits for a commit. For threads
+   that operations may wait for, such as the inode reaper, and for
+   writers that may hold other locks, such as page eviction. */
+void
+journal_begin_nowait (void)
+{
+  start_handle (false);
+}
+
+/* Open a handle for current thread, waiting for a commit to take
+   running transaction first if WAIT. */
+static void
+start_handle (bool wait)
+{
+  struct thread *t = thread_current ();
+
+  if (t->journal_depth++ > 0)
+    return;
+  lock_acquire (&journal_lock);
+  while (wait && journal_frozen)
+    cond_wait (&journal_cond, &journal_lock);
+  journal_active++;
+  journal_started++;
+  lock_release (&journal_lock);
+}
+
+/* End operation begun by journal_begin(). */
+void
+journal_end (void)
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (t->journal_depth > 0);
+  if (--t->journal_depth > 0)
+    return;
+  lock_acquire (&journal_lock);
+  if (--journal_active == 0)
+    cond_broadcast (&journal_cond, &journal_lock);
+  lock_release (&journal_lock);
+}
+
+/* Take a copy of metadata SECTOR, whose new contents are DATA,
+   into running transaction. Return false if the journal is not
+   open or out of memory; then caller must write SECTOR home
+   itself. */
+bool
+journal_log (block_sector_t sector, const void *data)
+{
+  struct journal_block *jb;
+
+  if (!journal_ready)
+    return false;
+
+  lock_acquire (&journal_lock);
+  jb = find_block (sector);
+  if (jb == NULL)
+  {
+    jb = calloc (1, sizeof *jb);
+    if (jb == NULL)
+    {
+      lock_release (&journal_lock);
+      return false;
+    }
+    jb->sector = sector;
+    hash_insert (&journal_blocks, &jb->hash_elem);
+  }
+  if (jb->running == NULL)
+    jb->running = malloc (BLOCK_SECTOR_SIZE);
+  if (jb->running == NULL)
+  {
+    /* Older copies must not overwrite the caller's write. */
+    forget_copies (jb);
+    drop_block (jb);
+    lock_release (&journal_lock);
+    return false;
+  }
+  memcpy (jb->running, data, BLOCK_SECTOR_SIZE);
+  jb->revoke = false;
+  queue_block (jb);
+  lock_release (&journal_lock);
+  return true;
+}
+
+/* Forget CNT sectors from SECTOR, which were just freed and may
+   come back as file data. Their copies are dropped, and running
+   transaction records them, so replay doesn't write old images
+   over their new contents. */
+void
+journal_revoke (block_sector_t sector, size_t cnt)
+{
+  lock_acquire (&journal_lock);
+  for (; cnt > 0; sector++, cnt--)
+  {
+    struct journal_block *jb = find_block (sector);
+
+    if (jb != NULL)
+    {
+      forget_copies (jb);
+      jb->revoke = true;
+      queue_block (jb);
+    }
+  }
+  lock_release (&journal_lock);
+}
+
+/* Read SECTOR into DATA: the newest copy in the journal if there
+   is one, since it may not be home yet, or else from disk. */
+void
+journal_read (block_sector_t sector, void *data)
+{
+  struct journal_block *jb;
+  const uint8_t *copy = NULL;
+
+  lock_acquire (&journal_lock);
+  jb = find_block (sector);
+  if (jb != NULL)
+  {
+    if (jb->running != NULL)
+      copy = jb->running;
+    else if (jb->committing != NULL && !jb->stale)
+      copy = jb->committing;
+    else
+      copy = jb->logged;
+  }
+  if (copy != NULL)
+    memcpy (data, copy, BLOCK_SECTOR_SIZE);
+  lock_release (&journal_lock);
+
+  if (copy == NULL)
+    block_read (fs_device, sector, data);
+}
+
+/* Read transaction SEQ from log sector HEAD and check it is
+   whole. Return the number of log sectors it takes, or 0 if there
+   is no such transaction. */
+static size_t
+scan_txn (size_t head, uint32_t seq)
+{
+  struct journal_desc *desc = &journal_desc_block;
+  uint32_t checksum = 0;
+  size_t pos = head;
+  size_t i;
+
+  /* Descriptors, each followed by its images, up to the commit
+     block. */
+  do
+  {
+    size_t data_cnt = 0;
+
+    if (pos + 2 > JOURNAL_SECTORS)
+      return 0;
+    block_read (fs_device, JOURNAL_SECTOR + pos, desc);
+    if (desc->magic != JOURNAL_DESC_MAGIC || desc->seq != seq
+        || desc->cnt > JOURNAL_DESC_ENTRIES)
+      return 0;
+    for (i = 0; i < desc->cnt; i++)
+      if (!(desc->entries[i] & JOURNAL_REVOKE))
+        data_cnt++;
+    if (pos + data_cnt + 2 > JOURNAL_SECTORS)
+      return 0;
+
+    checksum = checksum * 31 + hash_bytes (desc, sizeof *desc);
+    for (i = 0; i < data_cnt; i++)
+    {
+      block_read (fs_device, JOURNAL_SECTOR + pos + 1 + i, journal_image);
+      checksum = checksum * 31 + hash_bytes (journal_image,
+                                             BLOCK_SECTOR_SIZE);
+    }
+    pos += data_cnt + 1;
+    block_read (fs_device, JOURNAL_SECTOR + pos, &journal_commit_block);
+  }
+  while (journal_commit_block.magic == JOURNAL_DESC_MAGIC);
+
+  if (journal_commit_block.magic != JOURNAL_COMMIT_MAGIC
+      || journal_commit_block.seq != seq
+      || journal_commit_block.checksum != checksum)
+    return 0;
+  return pos + 1 - head;
+}
+
+/* Free journal block of hash element E, for hash_clear(). */
+static void
+free_block (struct hash_elem *e, void *aux UNUSED)
+{
+  free (hash_entry (e, struct journal_block, hash_elem));
+}
+
+/* Find the whole transactions in log, storing the log sector of
+   each in HEADS, and set journal_seq past the last. Return the
+   number found. Blocks left over from older transactions, or from
+   an earlier format, have lower sequence numbers and never match. */
+static size_t
+scan_log (size_t heads[])
+{
+  size_t txn_cnt = 0;
+  size_t head = 1;
+
+  block_read (fs_device, JOURNAL_SECTOR, &journal_super_block);
+  if (journal_super_block.magic != JOURNAL_MAGIC)
+  {
+    /* No journal on disk yet. */
+    journal_seq = 1;
+    return 0;
+  }
+  journal_seq = journal_super_block.seq;
+
+  while (true)
+  {
+    size_t len = scan_txn (head, journal_seq);
+
+    if (len == 0)
+      break;
+    heads[txn_cnt++] = head;
+    head += len;
+    journal_seq++;
+  }
+  return txn_cnt;
+}
+
+/* Replay committed transactions left in log by a crash, newest
+   first, so each sector is written home once, with its last
+   image, and not at all if it was freed later. Sectors already
+   decided are kept in journal_blocks. Set journal_seq past the
+   last transaction found, and return the number replayed. */
+static size_t
+recover (void)
+{
+  size_t heads[JOURNAL_SECTORS / 2];
+  size_t txn_cnt = scan_log (heads);
+  size_t replayed = txn_cnt;
+  size_t head;
+
+  lock_acquire (&journal_lock);
+  while (txn_cnt > 0)
+  {
+    struct journal_desc *desc = &journal_desc_block;
+    block_sector_t pos;
+    size_t i;
+
+    /* Each descriptor is followed by its images; the commit block
+       ends the transaction. */
+    head = heads[--txn_cnt];
+    pos = JOURNAL_SECTOR + head;
+    for (block_read (fs_device, pos++, desc);
+         desc->magic == JOURNAL_DESC_MAGIC;
+         block_read (fs_device, pos++, desc))
+      for (i = 0; i < desc->cnt; i++)
+      {
+        block_sector_t sector = desc->entries[i] & ~JOURNAL_REVOKE;
+        bool image = !(desc->entries[i] & JOURNAL_REVOKE);
+        struct journal_block *jb = find_block (sector);
+
+        if (jb == NULL)
+        {
+          jb = calloc (1, sizeof *jb);
+          if (jb == NULL)
+            PANIC ("journal: out of memory during replay");
+          jb->sector = sector;
+          hash_insert (&journal_blocks, &jb->hash_elem);
+          if (image)
+          {
+            block_read (fs_device, pos, journal_image);
+            block_write (fs_device, sector, journal_image);
+            journal_checkpoints++;
+          }
+        }
+        if (image)
+          pos++;
+      }
+  }
+  hash_clear (&journal_blocks, free_block);
+  lock_release (&journal_lock);
+
+  return replayed;
+}
+
+/* Open journal on file system device. If FORMAT, start an empty
+   one, numbering its transactions on from any old journal's so
+   none of their blocks can be replayed; otherwise replay
+   transactions a crash left in it first. Must be called before
+   metadata is read. */
+void
+journal_open (bool format)
+{
+  size_t heads[JOURNAL_SECTORS / 2];
+  size_t replayed = 0;
+
+  lock_acquire (&journal_commit_lock);
+  if (format)
+    scan_log (heads);
+  else
+    replayed = recover ();
+  if (replayed > 0)
+    printf ("journal: replayed %zu transactions\n", replayed);
+  write_super ();
+  journal_ready = true;
+  lock_release (&journal_commit_lock);
+}
+
+/* Commit and write every copy home, leaving the log empty, so
+   next boot has nothing to replay. Later changes to metadata go
+   home through buffer cache. */
+void
+journal_done (void)
+{
+  journal_commit ();
+  lock_acquire (&journal_commit_lock);
+  lock_acquire (&journal_lock);
+  write_all_home ();
+  journal_ready = false;
+  lock_release (&journal_lock);
+  lock_release (&journal_commit_lock);
+}
+
+/* Copy journal statistics into STATS. */
+void
+journal_get_stats (struct cache_stats *stats)
+{
+  lock_acquire (&journal_lock);
+  stats->journal_commits = journal_commits;
+  stats->journal_log_writes = journal_log_writes;
+  stats->journal_checkpoints = journal_checkpoints;
+  lock_release (&journal_lock);
+}
+
+/* Print journal statistics. */
+void
+journal_print_stats (void)
+{
+  struct cache_stats s;
+
+  journal_get_stats (&s);
+  printf ("Journal: %llu commits, %llu sectors logged, "
+          "%llu written home\n",
+          s.journal_commits, s.journal_log_writes, s.journal_checkpoints);
+}
+/////////////////////////////////////////////////////////////////////////////
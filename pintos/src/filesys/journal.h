@@ -0,0 +1,24 @@
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <cache-stats.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+
+void journal_init (void);
+void journal_open (bool format);
+void journal_done (void);
+void journal_begin (void);
+void journal_begin_nowait (void);
+void journal_end (void);
+void journal_commit (void);
+bool journal_log (block_sector_t sector, const void *data);
+void journal_revoke (block_sector_t sector, size_t cnt);
+void journal_read (block_sector_t sector, void *data);
+void journal_get_stats (struct cache_stats *stats);
+void journal_print_stats (void);
+
+#endif /* filesys/journal.h */
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,45 @@
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+#ifndef __LIB_CACHE_STATS_H
+#define __LIB_CACHE_STATS_H
+
+/* Kinds of file system sectors counted separately. */
+enum cache_class
+  {
+    CACHE_INODE,                /* On-disk inodes. */
+    CACHE_INDIRECT,             /* Indirect and double indirect blocks. */
+    CACHE_DATA,                 /* File contents. */
+    CACHE_METADATA,             /* Directory and free map contents. */
+    CACHE_CLASS_CNT
+  };
+
+/* Buffer cache and file system device statistics, as returned by
+   the cachestat system call. Counts are since boot. */
+struct cache_stats
+  {
+    unsigned long long hits;            /* Lookups found in cache. */
+    unsigned long long misses;          /* Lookups that filled an entry. */
+    unsigned long long evictions;       /* Entries reused for new sector. */
+    unsigned long long write_backs;     /* Dirty entries written to disk. */
+    unsigned long long ra_reads;        /* Sectors read ahead. */
+    unsigned long long ra_hits;         /* Read ahead, then used. */
+    unsigned long long ra_wasted;       /* Read ahead, evicted unused. */
+    unsigned long long lock_waits;      /* Blocked on a cache lock. */
+    unsigned long long class_hits[CACHE_CLASS_CNT];   /* Hits per class. */
+    unsigned long long class_misses[CACHE_CLASS_CNT]; /* Misses per class. */
+    unsigned long long disk_reads;      /* Sectors read from device. */
+    unsigned long long disk_writes;     /* Sectors written to device. */
+    unsigned long long disk_seek_dist;  /* Sectors skipped by seeks. */
+    unsigned long long disk_long_seeks; /* Seeks over 1024 sectors. */
+    unsigned long long dc_hits;         /* Names found in dentry cache. */
+    unsigned long long dc_neg_hits;     /* Known missing names. */
+    unsigned long long dc_misses;       /* Names looked up on disk. */
+    unsigned long long journal_commits; /* Metadata transactions logged. */
+    unsigned long long journal_log_writes;  /* Sectors written to log. */
+    unsigned long long journal_checkpoints; /* Logged sectors written
+                                               home. */
+    unsigned entry_cnt;                 /* Entries allocated now. */
+    unsigned dirty_cnt;                 /* Entries with dirty data now. */
+  };
+
+#endif /* lib/cache-stats.h */
+/////////////////////////////////////////////////////////////////////////////
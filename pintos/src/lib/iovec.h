@@ -0,0 +1,19 @@
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+#ifndef __LIB_IOVEC_H
+#define __LIB_IOVEC_H
+
+#include <stddef.h>
+
+/* One buffer of a vectored read or write, as passed to the readv
+   and writev system calls. */
+struct iovec
+  {
+    void *iov_base;             /* Start of buffer. */
+    size_t iov_len;             /* Size of buffer in bytes. */
+  };
+
+/* Most buffers accepted by one readv or writev call. */
+#define IOV_MAX 64
+
+#endif /* lib/iovec.h */
+/////////////////////////////////////////////////////////////////////////////
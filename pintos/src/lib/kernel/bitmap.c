@@ -46,6 +46,34 @@ bit_mask (size_t bit_idx)
   return (elem_type) 1 << (bit_idx % ELEM_BITS);
 }
 
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+/* Returns the index of the first bit in B at or after START
+   and before END that is set to VALUE, or END if there is none.
+   Looks at a whole element at a time, so a long run of bits
+   not set to VALUE costs one test per element, not per bit. */
+static size_t
+find_bit (const struct bitmap *b, size_t start, size_t end, bool value)
+{
+  size_t i = start;
+
+  while (i < end)
+    {
+      elem_type e = b->bits[elem_idx (i)];
+
+      if (!value)
+        e = ~e;
+      e &= (elem_type) -1 << (i % ELEM_BITS);
+      if (e != 0)
+        {
+          i = elem_idx (i) * ELEM_BITS + __builtin_ctzl (e);
+          return i < end ? i : end;
+        }
+      i = (elem_idx (i) + 1) * ELEM_BITS;
+    }
+  return end;
+}
+/////////////////////////////////////////////////////////////////////////////
+
 /* Returns the number of elements required for BIT_CNT bits. */
 static inline size_t
 elem_cnt (size_t bit_cnt)
@@ -251,16 +279,22 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  // size_t i;
+/////////////////////////////////////////////////////////////////////////////
   
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
-  return false;
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  /* old codes */
+  // for (i = 0; i < cnt; i++)
+    // if (bitmap_test (b, start + i) == value)
+      // return true;
+  // return false;
+  return find_bit (b, start, start + cnt, value) < start + cnt;
+/////////////////////////////////////////////////////////////////////////////
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -289,6 +323,36 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 
 /* Finding set or unset bits. */
 
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+/* Finds and returns the starting index of the first group of CNT
+   consecutive bits in B at or after START, and ending at or
+   before END, that are all set to VALUE.
+   If there is no such group, returns BITMAP_ERROR.
+   Candidate groups are found an element at a time, and a group
+   cut short by a bit not set to VALUE resumes the search past
+   that bit, so each bit is looked at about once. */
+static size_t
+scan_range (const struct bitmap *b, size_t start, size_t end, size_t cnt,
+            bool value)
+{
+  if (cnt == 0)
+    return start;
+  while (cnt <= end && start <= end - cnt)
+    {
+      size_t stop;
+
+      start = find_bit (b, start, end - cnt + 1, value);
+      if (start > end - cnt)
+        break;
+      stop = find_bit (b, start, start + cnt, !value);
+      if (stop == start + cnt)
+        return start;
+      start = stop + 1;
+    }
+  return BITMAP_ERROR;
+}
+/////////////////////////////////////////////////////////////////////////////
+
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
@@ -299,15 +363,19 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
-  if (cnt <= b->bit_cnt) 
-    {
-      size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
-    }
-  return BITMAP_ERROR;
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  /* old codes */
+  // if (cnt <= b->bit_cnt) 
+    // {
+      // size_t last = b->bit_cnt - cnt;
+      // size_t i;
+      // for (i = start; i <= last; i++)
+        // if (!bitmap_contains (b, i, cnt, !value))
+          // return i; 
+    // }
+  // return BITMAP_ERROR;
+  return scan_range (b, start, b->bit_cnt, cnt, value);
+/////////////////////////////////////////////////////////////////////////////
 }
 
 /* Finds the first group of CNT consecutive bits in B at or after
@@ -325,6 +393,63 @@ bitmap_scan_and_flip (struct bitmap *b, size_t start, size_t cnt, bool value)
     bitmap_set_multiple (b, idx, cnt, !value);
   return idx;
 }
+
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+/* Finds and returns the starting index of the first group of CNT
+   consecutive bits in B at or after START, and ending at or
+   before END, that are all set to VALUE.
+   If there is no such group, returns BITMAP_ERROR. */
+size_t
+bitmap_scan_range (const struct bitmap *b, size_t start, size_t end,
+                   size_t cnt, bool value)
+{
+  ASSERT (b != NULL);
+  ASSERT (start <= end);
+  ASSERT (end <= b->bit_cnt);
+
+  return scan_range (b, start, end, cnt, value);
+}
+
+/* Like bitmap_scan(), but for next-fit allocation: starts
+   looking at *HINT and wraps around to the beginning of B, so
+   repeated calls don't rescan the bits they used up before.  On
+   success, advances *HINT past the group found. */
+size_t
+bitmap_scan_next (const struct bitmap *b, size_t *hint, size_t cnt,
+                  bool value)
+{
+  size_t start, idx;
+
+  ASSERT (b != NULL);
+  ASSERT (hint != NULL);
+
+  start = *hint < b->bit_cnt ? *hint : 0;
+  idx = scan_range (b, start, b->bit_cnt, cnt, value);
+  if (idx == BITMAP_ERROR && start > 0)
+    {
+      /* Groups may straddle START, but needn't go further. */
+      size_t end = start + cnt - 1;
+      idx = scan_range (b, 0, end < b->bit_cnt ? end : b->bit_cnt,
+                        cnt, value);
+    }
+  if (idx != BITMAP_ERROR)
+    *hint = idx + cnt;
+  return idx;
+}
+
+/* Like bitmap_scan_and_flip(), but starts looking at *HINT as
+   bitmap_scan_next() does, and advances *HINT past the group
+   found. */
+size_t
+bitmap_scan_and_flip_next (struct bitmap *b, size_t *hint, size_t cnt,
+                           bool value)
+{
+  size_t idx = bitmap_scan_next (b, hint, cnt, value);
+  if (idx != BITMAP_ERROR)
+    bitmap_set_multiple (b, idx, cnt, !value);
+  return idx;
+}
+/////////////////////////////////////////////////////////////////////////////
 
 /* File input and output. */
 
@@ -359,6 +484,28 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+/* Writes the elements of B holding the CNT bits starting at
+   START to FILE, where bitmap_write() would put them.  Return
+   true if successful, false otherwise. */
+bool
+bitmap_write_part (const struct bitmap *b, struct file *file,
+                   size_t start, size_t cnt)
+{
+  off_t ofs, size;
+
+  ASSERT (b != NULL);
+  ASSERT (start <= b->bit_cnt);
+  ASSERT (start + cnt <= b->bit_cnt);
+
+  if (cnt == 0)
+    return true;
+  ofs = elem_idx (start) * sizeof (elem_type);
+  size = (elem_idx (start + cnt - 1) + 1) * sizeof (elem_type) - ofs;
+  return file_write_at (file, (char *) b->bits + ofs, size, ofs) == size;
+}
+/////////////////////////////////////////////////////////////////////////////
 #endif /* FILESYS */
 
 /* Debugging. */
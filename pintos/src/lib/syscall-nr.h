@@ -28,7 +28,22 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+    /* File system statistics. */
+    SYS_CACHESTAT,              /* Reads buffer cache statistics. */
+    SYS_FALLOCATE,              /* Reserves disk space for a file. */
+
+    /* Positional and vectored I/O. */
+    SYS_PREAD,                  /* Read from a file at an offset. */
+    SYS_PWRITE,                 /* Write to a file at an offset. */
+    SYS_READV,                  /* Read from a file into buffers. */
+    SYS_WRITEV,                 /* Write buffers to a file. */
+
+    /* Batched directory reads. */
+    SYS_READDIRS,               /* Reads many directory entries. */
+/////////////////////////////////////////////////////////////////////////////
   };
 
 #endif /* lib/syscall-nr.h */
@@ -61,6 +61,27 @@
           retval;                                               \
         })
 
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, ARG2,
+   and ARG3, and returns the return value as an `int'. */
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg3]; pushl %[arg2]; pushl %[arg1]; "    \
+             "pushl %[arg0]; pushl %[number]; int $0x30; "      \
+             "addl $20, %%esp"                                  \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "g" (ARG0),                             \
+                 [arg1] "g" (ARG1),                             \
+                 [arg2] "g" (ARG2),                             \
+                 [arg3] "g" (ARG3)                              \
+               : "memory");                                     \
+          retval;                                               \
+        })
+/////////////////////////////////////////////////////////////////////////////
+
 void
 halt (void) 
 {
@@ -182,3 +203,47 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+bool
+cachestat (struct cache_stats *stats)
+{
+  return syscall1 (SYS_CACHESTAT, stats);
+}
+
+bool
+fallocate (int fd, unsigned length, int flags)
+{
+  return syscall3 (SYS_FALLOCATE, fd, length, flags);
+}
+
+int
+pread (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PREAD, fd, buffer, size, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PWRITE, fd, buffer, size, offset);
+}
+
+int
+readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_WRITEV, fd, iov, iovcnt);
+}
+
+int
+readdirs (unsigned *pos, char names[][READDIR_MAX_LEN + 1], int cnt)
+{
+  return syscall3 (SYS_READDIRS, pos, names, cnt);
+}
+/////////////////////////////////////////////////////////////////////////////
@@ -3,6 +3,10 @@
 
 #include <stdbool.h>
 #include <debug.h>
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+#include <cache-stats.h>
+#include <iovec.h>
+/////////////////////////////////////////////////////////////////////////////
 
 /* Process identifier. */
 typedef int pid_t;
@@ -45,4 +49,27 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+/* File system statistics. */
+bool cachestat (struct cache_stats *stats);
+
+/* Flags for fallocate(). */
+#define FALLOC_CONTIGUOUS 0x1   /* Reserve one contiguous run. */
+#define FALLOC_NO_ZERO 0x2      /* Don't zero; needs FALLOC_KEEP_SIZE. */
+#define FALLOC_KEEP_SIZE 0x4    /* Don't extend the file. */
+
+/* Space reservation. */
+bool fallocate (int fd, unsigned length, int flags);
+
+/* Positional and vectored I/O. */
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+
+/* Batched directory reads. */
+#define READDIRS_MAX 64         /* Most names one readdirs() returns. */
+int readdirs (unsigned *pos, char names[][READDIR_MAX_LEN + 1], int cnt);
+/////////////////////////////////////////////////////////////////////////////
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,163 @@
+/* Test program and benchmark for lib/kernel/bitmap.c.
+
+   Checks bitmap_scan(), bitmap_scan_range(), bitmap_contains()
+   and bitmap_scan_next() against a bit-at-a-time reference on
+   random bitmaps, then times the reference and bitmap_scan() on
+   the free map of a nearly full 8 MB disk.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <bitmap.h>
+#include <debug.h>
+#include <random.h>
+#include <stdio.h>
+#include "devices/block.h"
+#include "devices/timer.h"
+#include "threads/test.h"
+
+/* Largest bitmap checked against the reference. */
+#define MAX_SIZE 300
+
+/* Sectors in an 8 MB disk. */
+#define DISK_SECTORS (8 * 1024 * 1024 / BLOCK_SECTOR_SIZE)
+
+/* Percentage of DISK_SECTORS in use for the benchmark. */
+#define PERCENT_FULL 97
+
+/* Scans timed per run length. */
+#define BENCH_ITERATIONS 100
+
+static size_t reference_scan (const struct bitmap *, size_t start,
+                              size_t cnt, bool value);
+static void fill_random (struct bitmap *, int percent);
+static void check_scans (void);
+static void benchmark (void);
+
+/* Test the bitmap implementation. */
+void
+test (void)
+{
+  check_scans ();
+  benchmark ();
+}
+
+/* Finds the first group of CNT bits in B at or after START that
+   are all set to VALUE, testing one bit at a time, the way
+   bitmap_scan() used to. */
+static size_t
+reference_scan (const struct bitmap *b, size_t start, size_t cnt,
+                bool value)
+{
+  size_t i, j;
+
+  if (cnt > bitmap_size (b))
+    return BITMAP_ERROR;
+  for (i = start; i <= bitmap_size (b) - cnt; i++)
+    {
+      for (j = 0; j < cnt; j++)
+        if (bitmap_test (b, i + j) != value)
+          break;
+      if (j == cnt)
+        return i;
+    }
+  return BITMAP_ERROR;
+}
+
+/* Sets about PERCENT percent of the bits in B, at random. */
+static void
+fill_random (struct bitmap *b, int percent)
+{
+  size_t i;
+
+  for (i = 0; i < bitmap_size (b); i++)
+    bitmap_set (b, i, random_ulong () % 100 < (unsigned long) percent);
+}
+
+/* Compares scans of random bitmaps of every size up to MAX_SIZE
+   with reference_scan(). */
+static void
+check_scans (void)
+{
+  size_t size;
+
+  printf ("checking bitmap scans:");
+  for (size = 0; size <= MAX_SIZE; size++)
+    {
+      struct bitmap *b = bitmap_create (size);
+      int repeat;
+
+      ASSERT (b != NULL);
+      if (size % 50 == 0)
+        printf (" %zu", size);
+      for (repeat = 0; repeat < 20; repeat++)
+        {
+          size_t start = random_ulong () % (size + 1);
+          size_t cnt = random_ulong () % 12;
+          bool value = random_ulong () % 2;
+          size_t expected, hint;
+
+          fill_random (b, random_ulong () % 101);
+
+          expected = reference_scan (b, start, cnt, value);
+          ASSERT (bitmap_scan (b, start, cnt, value) == expected);
+          ASSERT (bitmap_scan_range (b, start, size, cnt, value) == expected);
+          if (start + cnt <= size)
+            {
+              bool any = bitmap_count (b, start, cnt, value) > 0;
+              ASSERT (bitmap_contains (b, start, cnt, value) == any);
+            }
+
+          /* Next fit wraps around to the start of B. */
+          if (cnt > 0 && start < size)
+            {
+              if (expected == BITMAP_ERROR)
+                expected = reference_scan (b, 0, cnt, value);
+              hint = start;
+              ASSERT (bitmap_scan_next (b, &hint, cnt, value) == expected);
+              ASSERT (expected == BITMAP_ERROR || hint == expected + cnt);
+            }
+        }
+      bitmap_destroy (b);
+    }
+  printf (" done\n");
+}
+
+/* Times reference_scan() against bitmap_scan() for runs of
+   several lengths on a nearly full disk free map. */
+static void
+benchmark (void)
+{
+  static const size_t runs[] = {1, 8, 64};
+  struct bitmap *b = bitmap_create (DISK_SECTORS);
+  size_t i;
+
+  ASSERT (b != NULL);
+  fill_random (b, PERCENT_FULL);
+  printf ("scanning %d sectors, %d%% in use, %d times each:\n",
+          DISK_SECTORS, PERCENT_FULL, BENCH_ITERATIONS);
+  for (i = 0; i < sizeof runs / sizeof *runs; i++)
+    {
+      int64_t start;
+      int64_t old_ticks, new_ticks;
+      size_t expected = reference_scan (b, 0, runs[i], false);
+      int j;
+
+      start = timer_ticks ();
+      for (j = 0; j < BENCH_ITERATIONS; j++)
+        reference_scan (b, 0, runs[i], false);
+      old_ticks = timer_elapsed (start);
+
+      start = timer_ticks ();
+      for (j = 0; j < BENCH_ITERATIONS; j++)
+        ASSERT (bitmap_scan (b, 0, runs[i], false) == expected);
+      new_ticks = timer_elapsed (start);
+
+      printf ("  run of %zu: bit at a time %"PRId64" ticks, "
+              "word at a time %"PRId64" ticks\n",
+              runs[i], old_ticks, new_ticks);
+    }
+  bitmap_destroy (b);
+}
@@ -36,6 +36,9 @@
 #include "devices/ide.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+#include "filesys/buffer_cache.h"
+/////////////////////////////////////////////////////////////////////////////
 #endif
 //////////////////////////////// PJ3 EDITED /////////////////////////////////
 #include "vm/frame.h"
@@ -56,6 +59,18 @@ static const char *scratch_bdev_name;
 #ifdef VM
 static const char *swap_bdev_name;
 #endif
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+/* -bc, -bcmax: Number of buffer cache entries at boot, and
+   limit the buffer cache may grow to while memory is free. */
+static size_t bc_entry_nb;
+static size_t bc_max_entry_nb;
+
+/* -bcflush, -bcdirty: Buffer cache write back interval in
+   milliseconds, and percent of dirty entries that triggers an
+   early write back. */
+static int bc_flush_ms;
+static int bc_dirty_ratio;
+/////////////////////////////////////////////////////////////////////////////
 #endif /* FILESYS */
 
 /* -ul: Maximum number of pages to put into palloc's user pool. */
@@ -128,6 +143,10 @@ main (void)
   /* Initialize file system. */
   ide_init ();
   locate_block_devices ();
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  bc_configure (bc_entry_nb, bc_max_entry_nb);
+  bc_configure_flusher (bc_flush_ms, bc_dirty_ratio);
+/////////////////////////////////////////////////////////////////////////////
   filesys_init (format_filesys);
 #endif
 
@@ -260,6 +279,21 @@ parse_options (char **argv)
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
 #endif
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+      else if (!strcmp (name, "-bc"))
+        bc_entry_nb = atoi (value);
+      else if (!strcmp (name, "-bcmax"))
+        bc_max_entry_nb = atoi (value);
+      else if (!strcmp (name, "-bcflush"))
+        bc_flush_ms = atoi (value);
+      else if (!strcmp (name, "-bcdirty"))
+        bc_dirty_ratio = atoi (value);
+      else if (!strcmp (name, "-bcpolicy"))
+        {
+          if (value == NULL || !bc_configure_policy (value))
+            PANIC ("unknown buffer cache policy `%s'", value);
+        }
+/////////////////////////////////////////////////////////////////////////////
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
@@ -385,6 +419,11 @@ usage (void)
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
+          "  -bc=COUNT          Use COUNT sectors of buffer cache.\n"
+          "  -bcmax=COUNT       Let buffer cache grow to COUNT sectors.\n"
+          "  -bcflush=MS        Write back buffer cache every MS ms.\n"
+          "  -bcdirty=PERCENT   Write back early at PERCENT dirty.\n"
+          "  -bcpolicy=NAME     Replace buffer cache by clock, 2q or arc.\n"
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
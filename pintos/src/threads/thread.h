@@ -133,6 +133,10 @@ struct thread
     struct hash vm;                     /* hash table for vm */
     struct list mmap_list;              /* list for memory mapped file */
 /////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+    int journal_depth;                  /* Nesting of journal operations. */
+/////////////////////////////////////////////////////////////////////////////
   };
 
 /* If false (default), use round-robin scheduler.
@@ -18,9 +18,22 @@
 #include "threads/malloc.h"
 #include "vm/frame.h"
 /////////////////////////////////////////////////////////////////////////////
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+#include <limits.h>
+#include "filesys/buffer_cache.h"
+#include "filesys/dentry_cache.h"
+#include "filesys/directory.h"
+#include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "threads/palloc.h"
+/////////////////////////////////////////////////////////////////////////////
 
 static void syscall_handler (struct intr_frame *);
 void do_munmap (struct mmap_file *mmap_file);
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+static int file_io (struct file *f, const struct iovec *iov, int iovcnt,
+                    off_t offset, bool write);
+/////////////////////////////////////////////////////////////////////////////
 
 void
 syscall_init (void)
@@ -38,7 +51,10 @@ syscall_init (void)
 static void
 syscall_handler (struct intr_frame *f UNUSED)
 {
-  int arg[3];
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  // int arg[3];
+  int arg[4];
+/////////////////////////////////////////////////////////////////////////////
 
   check_address (f->esp, f->esp);
   switch (*(int *)f->esp)
@@ -108,6 +124,48 @@ syscall_handler (struct intr_frame *f UNUSED)
       get_argument (f->esp, arg, 1);
       munmap (arg[0]);
       break;
+    case SYS_CACHESTAT:              /* Reads buffer cache statistics. */
+      get_argument (f->esp, arg, 1);
+      check_valid_buffer ((void *)arg[0], sizeof (struct cache_stats),
+                          f->esp, true);
+      f->eax = (uint32_t)cachestat ((struct cache_stats *)arg[0]);
+      break;
+    case SYS_FALLOCATE:              /* Reserves disk space for a file. */
+      get_argument (f->esp, arg, 3);
+      f->eax = (uint32_t)fallocate (arg[0], (unsigned)arg[1], arg[2]);
+      break;
+    case SYS_PREAD:                  /* Read from a file at an offset. */
+      get_argument (f->esp, arg, 4);
+      check_valid_buffer ((void *)arg[1], (unsigned)arg[2], f->esp, true);
+      f->eax = (uint32_t)pread (arg[0], (void *)arg[1], (unsigned)arg[2],
+                                (unsigned)arg[3]);
+      break;
+    case SYS_PWRITE:                 /* Write to a file at an offset. */
+      get_argument (f->esp, arg, 4);
+      check_valid_buffer ((void *)arg[1], (unsigned)arg[2], f->esp, false);
+      f->eax = (uint32_t)pwrite (arg[0], (void *)arg[1], (unsigned)arg[2],
+                                 (unsigned)arg[3]);
+      break;
+    case SYS_READV:                  /* Read from a file into buffers. */
+      get_argument (f->esp, arg, 3);
+      check_valid_iovec ((struct iovec *)arg[1], arg[2], f->esp, true);
+      f->eax = (uint32_t)readv (arg[0], (struct iovec *)arg[1], arg[2]);
+      break;
+    case SYS_WRITEV:                 /* Write buffers to a file. */
+      get_argument (f->esp, arg, 3);
+      check_valid_iovec ((struct iovec *)arg[1], arg[2], f->esp, false);
+      f->eax = (uint32_t)writev (arg[0], (struct iovec *)arg[1], arg[2]);
+      break;
+    case SYS_READDIRS:               /* Reads many directory entries. */
+      get_argument (f->esp, arg, 3);
+      check_valid_buffer ((void *)arg[0], sizeof (unsigned), f->esp, true);
+      if (arg[2] > 0)
+        check_valid_buffer ((void *)arg[1],
+                            (arg[2] < READDIRS_MAX ? arg[2] : READDIRS_MAX)
+                            * (READDIR_MAX_LEN + 1), f->esp, true);
+      f->eax = (uint32_t)readdirs ((unsigned *)arg[0], (void *)arg[1],
+                                   arg[2]);
+      break;
     default:
       printf ("Error: invalid system call %d\n", *(int *)f->esp);
       thread_exit ();
@@ -136,17 +194,37 @@ check_address (const void *addr, void *esp UNUSED)
 void
 check_valid_buffer (void *buffer, unsigned size, void *esp UNUSED, bool to_write)
 {
-  unsigned i;
-
-  for (i = 0; i < size; i++)
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  /* old codes */
+  // unsigned i;
+
+  // for (i = 0; i < size; i++)
+  // {
+    // struct vm_entry *vme = check_address (buffer + i, esp);
+
+    // if (vme == NULL)
+      // exit (-1);
+    // if (to_write && !vme->writable)
+      // exit (-1);
+  // }
+
+  /* All bytes of a page share its vm_entry, so check one byte
+     per page instead of every byte. */
+  void *end = buffer + size;
+  void *addr;
+
+  if (end < buffer)
+    exit (-1);
+  for (addr = buffer; addr < end; addr = pg_round_down (addr) + PGSIZE)
   {
-    struct vm_entry *vme = check_address (buffer + i, esp);
+    struct vm_entry *vme = check_address (addr, esp);
 
     if (vme == NULL)
       exit (-1);
     if (to_write && !vme->writable)
       exit (-1);
   }
+/////////////////////////////////////////////////////////////////////////////
 }
 
 /* for system calls that are using string for their argument,
@@ -284,8 +362,8 @@ read (int fd, void *buffer, unsigned size)
   struct file *f;
   int bytes = 0;
 
-  /* Acquire lock for the case of multiple file access. */
-  lock_acquire (&filesys_lock);
+  /* No global lock: inode_read_at() locks the byte range it
+     reads, so readers and writers of disjoint ranges overlap. */
   if (fd == STDIN_FILENO)
   {
     uint8_t byte;
@@ -295,15 +373,13 @@ read (int fd, void *buffer, unsigned size)
   }
   else
   {
+    struct iovec iov = {buffer, size};
+
     f = process_get_file (fd);
     if (f == NULL)
-    {
-      lock_release (&filesys_lock);
       return -1;
-    }
-    bytes = file_read (f, buffer, size);
+    bytes = file_io (f, &iov, 1, -1, false);
   }
-  lock_release (&filesys_lock);
 
   return bytes;
 }
@@ -319,8 +395,8 @@ write (int fd, const void *buffer, unsigned size)
   struct file *f;
   int bytes = 0;
 
-  /* Acquire lock for the case of multiple file access. */
-  lock_acquire (&filesys_lock);
+  /* No global lock: inode_write_at() locks the byte range it
+     writes, and only growth of a file is serialized. */
   if (fd == STDOUT_FILENO)
   {
     putbuf ((char *)buffer, size);
@@ -328,15 +404,13 @@ write (int fd, const void *buffer, unsigned size)
   }
   else
   {
+    struct iovec iov = {(void *)buffer, size};
+
     f = process_get_file (fd);
     if (f == NULL)
-    {
-      lock_release (&filesys_lock);
       return -1;
-    }
-    bytes = file_write (f, buffer, size);
+    bytes = file_io (f, &iov, 1, -1, true);
   }
-  lock_release (&filesys_lock);
 
   return bytes;
 }
@@ -515,3 +589,289 @@ do_munmap (struct mmap_file *mmap_file)
   file_close (file);
 }
 /////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+/* Copy buffer cache, dentry cache, journal and file system device
+   statistics to STATS. The copy is taken first, so a page fault
+   on STATS can't happen while a cache is locked. */
+bool
+cachestat (struct cache_stats *stats)
+{
+  struct cache_stats copy;
+
+  bc_get_stats (&copy);
+  dc_get_stats (&copy);
+  journal_get_stats (&copy);
+  memcpy (stats, &copy, sizeof copy);
+  return true;
+}
+
+/* Reserve disk space for the first LENGTH bytes of file which
+   corresponds to fd, so later writes there don't allocate.
+   FLAGS is a combination of FALLOC_*. FALLOC_NO_ZERO is refused
+   without FALLOC_KEEP_SIZE, so stale disk contents never become
+   readable. Return true if success. */
+bool
+fallocate (int fd, unsigned length, int flags)
+{
+  enum inode_reserve_flags reserve_flags = 0;
+  struct file *f;
+
+  if ((int) length < 0)
+    return false;
+  if ((flags & FALLOC_NO_ZERO) && !(flags & FALLOC_KEEP_SIZE))
+    return false;
+  if (flags & FALLOC_CONTIGUOUS)
+    reserve_flags |= INODE_RESERVE_CONTIGUOUS;
+  if (flags & FALLOC_NO_ZERO)
+    reserve_flags |= INODE_RESERVE_NO_ZERO;
+  if (flags & FALLOC_KEEP_SIZE)
+    reserve_flags |= INODE_RESERVE_KEEP_SIZE;
+
+  f = process_get_file (fd);
+  return f != NULL && inode_reserve (file_get_inode (f), length,
+                                     reserve_flags);
+}
+
+/* Return true if IOVCNT is a count of buffers readv() and
+   writev() accept, and the buffers of IOV add up to no more than
+   they can return. */
+static bool
+iovec_ok (const struct iovec *iov, int iovcnt)
+{
+  size_t total = 0;
+  int i;
+
+  if (iovcnt <= 0 || iovcnt > IOV_MAX)
+    return false;
+  for (i = 0; i < iovcnt; i++)
+  {
+    if (iov[i].iov_len > INT_MAX - total)
+      return false;
+    total += iov[i].iov_len;
+  }
+  return true;
+}
+
+/* For readv() and writev(), check the IOVCNT entries of IOV and
+   every buffer they describe, the way check_valid_buffer() does.
+   A count iovec_ok() rejects is left for the call to fail. */
+void
+check_valid_iovec (const struct iovec *iov, int iovcnt, void *esp,
+                   bool to_write)
+{
+  int i;
+
+  if (iovcnt <= 0 || iovcnt > IOV_MAX)
+    return;
+  check_valid_buffer ((void *)iov, iovcnt * sizeof *iov, esp, false);
+  for (i = 0; i < iovcnt; i++)
+    check_valid_buffer (iov[i].iov_base, iov[i].iov_len, esp, to_write);
+}
+
+/* Copy SIZE bytes between BUF and the IOVCNT user buffers of
+   IOV, starting OFS bytes into them: into BUF if TO_BUF, and out
+   of BUF otherwise. */
+static void
+iov_copy (const struct iovec *iov, int iovcnt, size_t ofs, uint8_t *buf,
+          size_t size, bool to_buf)
+{
+  int i;
+
+  for (i = 0; i < iovcnt && size > 0; i++)
+  {
+    uint8_t *base = iov[i].iov_base;
+    size_t n;
+
+    if (ofs >= iov[i].iov_len)
+    {
+      ofs -= iov[i].iov_len;
+      continue;
+    }
+    n = iov[i].iov_len - ofs;
+    if (n > size)
+      n = size;
+    if (to_buf)
+      memcpy (buf, base + ofs, n);
+    else
+      memcpy (base + ofs, buf, n);
+    buf += n;
+    size -= n;
+    ofs = 0;
+  }
+}
+
+/* Read F into the IOVCNT user buffers of IOV in turn, or write
+   them to F if WRITE, starting at OFFSET, or at F's position,
+   which is advanced, if OFFSET is negative. Data goes through a
+   kernel page a page at a time, so a page fault on a user buffer,
+   which may be mapped from F itself, never happens while the
+   inode's range or a cache buffer is locked. Each page is read
+   or written atomically. Return bytes moved, or -1 if out of
+   memory. */
+static int
+file_io (struct file *f, const struct iovec *iov, int iovcnt, off_t offset,
+         bool write)
+{
+  off_t pos = offset < 0 ? file_tell (f) : offset;
+  size_t total = 0, done = 0;
+  uint8_t *bounce;
+  int i;
+
+  for (i = 0; i < iovcnt; i++)
+    total += iov[i].iov_len;
+  bounce = palloc_get_page (0);
+  if (bounce == NULL)
+    return -1;
+
+  while (done < total)
+  {
+    size_t len = total - done < PGSIZE ? total - done : PGSIZE;
+    off_t n;
+
+    if (write)
+    {
+      iov_copy (iov, iovcnt, done, bounce, len, true);
+      n = file_write_at (f, bounce, len, pos);
+    }
+    else
+    {
+      n = file_read_at (f, bounce, len, pos);
+      iov_copy (iov, iovcnt, done, bounce, n, false);
+    }
+    pos += n;
+    done += n;
+    if ((size_t) n < len)
+      break;
+  }
+  palloc_free_page (bounce);
+
+  if (offset < 0)
+    file_seek (f, pos);
+  return done;
+}
+
+/* Read SIZE bytes from file FD into BUFFER, starting at OFFSET
+   instead of the file position, which is left unchanged.
+   Return bytes read, or -1 if FD is not an open file. */
+int
+pread (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  struct file *f = process_get_file (fd);
+  struct iovec iov = {buffer, size};
+
+  if (f == NULL || (off_t)offset < 0)
+    return -1;
+  return file_io (f, &iov, 1, offset, false);
+}
+
+/* Write SIZE bytes from BUFFER to file FD, starting at OFFSET
+   instead of the file position, which is left unchanged.
+   Return bytes written, or -1 if FD is not an open file. */
+int
+pwrite (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  struct file *f = process_get_file (fd);
+  struct iovec iov = {(void *)buffer, size};
+
+  if (f == NULL || (off_t)offset < 0)
+    return -1;
+  return file_io (f, &iov, 1, offset, true);
+}
+
+/* Read from FD into the IOVCNT buffers of IOV in turn, as one
+   read() into all of them would. A file is read a page at a time
+   across buffer boundaries. Return bytes read, or -1 on error. */
+int
+readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  struct file *f;
+  int bytes = 0;
+  int i;
+
+  if (!iovec_ok (iov, iovcnt))
+    return -1;
+  if (fd == STDIN_FILENO)
+  {
+    for (i = 0; i < iovcnt; i++)
+    {
+      int n = read (fd, iov[i].iov_base, iov[i].iov_len);
+
+      bytes += n;
+      if ((unsigned)n < iov[i].iov_len)
+        break;
+    }
+    return bytes;
+  }
+
+  f = process_get_file (fd);
+  if (f == NULL)
+    return -1;
+  return file_io (f, iov, iovcnt, -1, false);
+}
+
+/* Write the IOVCNT buffers of IOV in turn to FD, as one write()
+   of all of them would. A file is written a page at a time
+   across buffer boundaries. Return bytes written, or -1 on
+   error. */
+int
+writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  struct file *f;
+  int bytes = 0;
+  int i;
+
+  if (!iovec_ok (iov, iovcnt))
+    return -1;
+  if (fd == STDOUT_FILENO)
+  {
+    for (i = 0; i < iovcnt; i++)
+    {
+      putbuf (iov[i].iov_base, iov[i].iov_len);
+      bytes += iov[i].iov_len;
+    }
+    return bytes;
+  }
+
+  f = process_get_file (fd);
+  if (f == NULL)
+    return -1;
+  return file_io (f, iov, iovcnt, -1, true);
+}
+
+/* Read up to CNT names of the root directory into NAMES,
+   starting at position *POS, which is 0 for the first call, and
+   set *POS to where the next call should start. A call fills at
+   most READDIRS_MAX names. The names are read into a kernel
+   buffer first, so a page fault on NAMES can't happen while the
+   directory is locked. Return the number of names read, 0 at the
+   end of the directory, or -1 on error. */
+int
+readdirs (unsigned *pos, char names[][READDIR_MAX_LEN + 1], int cnt)
+{
+  char (*copy)[NAME_MAX + 1];
+  struct dir *dir;
+  int n;
+
+  if (cnt <= 0 || (off_t)*pos < 0)
+    return -1;
+  if (cnt > READDIRS_MAX)
+    cnt = READDIRS_MAX;
+  copy = malloc (cnt * sizeof *copy);
+  dir = dir_open_root ();
+  if (copy == NULL || dir == NULL)
+  {
+    free (copy);
+    dir_close (dir);
+    return -1;
+  }
+
+  dir_seek (dir, *pos);
+  n = dir_readdir_many (dir, copy, cnt);
+  *pos = dir_tell (dir);
+  dir_close (dir);
+  memcpy (names, copy, n * sizeof *copy);
+  free (copy);
+  return n;
+}
+/////////////////////////////////////////////////////////////////////////////
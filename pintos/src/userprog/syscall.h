@@ -38,4 +38,16 @@ int mmap (int fd, void *addr);
 void munmap (mapid_t mapid);
 /////////////////////////////////////////////////////////////////////////////
 
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+bool cachestat (struct cache_stats *stats);
+bool fallocate (int fd, unsigned length, int flags);
+void check_valid_iovec (const struct iovec *iov, int iovcnt, void *esp,
+                        bool to_write);
+int pread (int fd, void *buffer, unsigned size, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned size, unsigned offset);
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+int readdirs (unsigned *pos, char names[][READDIR_MAX_LEN + 1], int cnt);
+/////////////////////////////////////////////////////////////////////////////
+
 #endif /* userprog/syscall.h */
@@ -9,6 +9,8 @@
 #include "threads/thread.h"
 #include "userprog/pagedir.h"
 #include "filesys/file.h"
+#include "filesys/buffer_cache.h"
+#include "filesys/journal.h"
 
 struct list lru_list;
 struct lock lru_list_lock;
@@ -104,6 +106,16 @@ try_to_free_pages (enum palloc_flags flags)
   struct page *victim;
   uint32_t *pagedir = thread_current ()->pagedir;
 
+  /* Take back a page lent to buffer cache before
+     evicting any user page. */
+  if ((flags & PAL_USER) && bc_shrink ())
+  {
+    void *kaddr = palloc_get_page (flags);
+
+    if (kaddr != NULL)
+      return kaddr;
+  }
+
   while (1)
   {
     struct page *cur_page;
@@ -140,10 +152,14 @@ try_to_free_pages (enum palloc_flags flags)
     case VM_FILE:
       if (pagedir_is_dirty (pagedir, victim->vme->vaddr))
       {
+        /* The faulting thread may be inside a journal operation
+           that a commit waits for, so don't wait for the commit. */
+        journal_begin_nowait ();
         file_write_at (victim->vme->file,
                        victim->vme->vaddr,
                        victim->vme->read_bytes,
                        victim->vme->offset);
+        journal_end ();
       }
       break;
     case VM_ANON:
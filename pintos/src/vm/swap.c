@@ -5,6 +5,9 @@
 #include "threads/vaddr.h"
 
 struct bitmap *swap_bitmap;
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+static size_t swap_hint;        /* Where next search for a free slot starts. */
+/////////////////////////////////////////////////////////////////////////////
 
 void
 swap_init (void)
@@ -31,7 +34,11 @@ swap_out (void *kaddr)
   struct block *b = block_get_role (BLOCK_SWAP);
   int i, index, block_per_page = PGSIZE / BLOCK_SECTOR_SIZE;
 
-  index = bitmap_scan_and_flip (swap_bitmap, 0, 1, false);
+//////////////////////////////// PJ4 EDITED /////////////////////////////////
+  /* old code */
+  // index = bitmap_scan_and_flip (swap_bitmap, 0, 1, false);
+  index = bitmap_scan_and_flip_next (swap_bitmap, &swap_hint, 1, false);
+/////////////////////////////////////////////////////////////////////////////
   for (i = 0; i < block_per_page; i++)
     block_write (b, index * block_per_page + i, kaddr + BLOCK_SECTOR_SIZE * i);
 